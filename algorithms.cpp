@@ -1,6 +1,10 @@
 #include "algorithms.h"
 
-QImage ImageAlgorithms::convolving(const QImage &image, double **matrix, int size) {
+#include <cstring>
+#include <QThread>
+#include <QtConcurrent>
+
+QImage ImageAlgorithms::convolving(const QImage &image, const double * const *matrix, int size) {
     QImage result(image);
 
     for (int y = 0; y < image.height(); y++) {
@@ -25,7 +29,7 @@ QImage ImageAlgorithms::convolving(const QImage &image, double **matrix, int siz
     return result;
 }
 
-void ImageAlgorithms::convolving(double **val, int width, int height, const QImage &image, double *matrix, int size) {
+void ImageAlgorithms::convolving(double **val, int width, int height, const QImage &image, const double *matrix, int size) {
     for (int y = 0; y < image.height(); y++) {
         for (int x = 0; x < image.width(); x++) {
             double matrix_sum_r = 0, matrix_sum_g = 0, matrix_sum_b = 0;
@@ -45,6 +49,394 @@ void ImageAlgorithms::convolving(double **val, int width, int height, const QIma
     }
 }
 
+static inline void gradientPixel(double gx, double gy, quint16 &magnitude, uchar &orientation) {
+    const double tan_22_5 = 0.41421356;
+    double ax = fabs(gx), ay = fabs(gy);
+    magnitude = (quint16)std::min(65535.0, ax + ay + 0.5);
+    // y axis looks down, so gradient with equal signs points down right
+    orientation = ay <= ax * tan_22_5 ? 0 : (ax <= ay * tan_22_5 ? 2 : (gx * gy > 0 ? 1 : 3));
+}
+
+void ImageAlgorithms::gradientPlanes(const QImage &image, const double *matrix_x, const double *matrix_y, int size, quint16 *magnitude, uchar *orientation) {
+    QImage rgb = image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32 ? image : image.convertToFormat(QImage::Format_ARGB32);
+    int width = rgb.width(), height = rgb.height(), half = size / 2;
+
+    // gx and gy live only while their pixel is packed, border pixels get zero gradient as in convolving
+    QtConcurrent::blockingMap(rowBands(height), [&](const QPair<int, int> &band) {
+        for (int y = band.first; y < band.second; y++) {
+            for (int x = 0; x < width; x++) {
+                double gx = 0, gy = 0;
+                if (x > half && y > half && x < width - half && y < height - half) {
+                    for (int j = 0; j < size; j++) {
+                        const QRgb *line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y + j - half)) + x - half;
+                        for (int i = 0; i < size; i++) {
+                            int sum = qRed(line[i]) + qGreen(line[i]) + qBlue(line[i]);
+                            gx += sum * matrix_x[j * size + i];
+                            gy += sum * matrix_y[j * size + i];
+                        }
+                    }
+                }
+                gradientPixel(gx / 3, gy / 3, magnitude[y * width + x], orientation[y * width + x]);
+            }
+        }
+    });
+}
+
+void ImageAlgorithms::gradientPlanes(const float *values_x, const float *values_y, int count, quint16 *magnitude, uchar *orientation) {
+    for (int k = 0; k < count; k++) {
+        gradientPixel(values_x[k], values_y[k], magnitude[k], orientation[k]);
+    }
+}
+
+void ImageAlgorithms::nonMaximumSuppression(const quint16 *magnitude, const uchar *orientation, int width, int height, quint16 *result) {
+    // neighbour along gradient for every orientation bin, the other one is mirrored
+    const int offsets[4] = {1, width + 1, width, width - 1};
+    std::fill(result, result + width * height, 0);
+    for (int y = 1; y < height - 1; y++) {
+        const quint16 *mag = magnitude + y * width;
+        const uchar *orient = orientation + y * width;
+        quint16 *out = result + y * width;
+        for (int x = 1; x < width - 1; x++) {
+            int off = offsets[orient[x]];
+            quint16 m = mag[x];
+            out[x] = (m > mag[x + off] && m > mag[x - off]) ? m : 0;
+        }
+    }
+}
+
+void ImageAlgorithms::hysteresisThreshold(const quint16 *magnitude, int width, int height, int low, int high, bool hysteresis, uchar *result) {
+    QVector<uchar> dtf(width * height);
+    for (int k = 0; k < width * height; k++) {
+        dtf[k] = (magnitude[k] > low) * (1 + (magnitude[k] >= high));
+    }
+    std::copy(dtf.constBegin(), dtf.constEnd(), result);
+
+    if (! hysteresis)
+        return;
+    for (int y = 1; y < height - 1; y++) {
+        for (int x = 1; x < width - 1; x++) {
+            int k = y * width + x;
+            if (dtf[k] == 1) {
+                bool found = false;
+                for (int j = -1; j <= 1; j++) {
+                    for (int i = -1; i <= 1; i++) {
+                        if (dtf[k + j * width + i] == 2)
+                            found = true;
+                    }
+                }
+                if (! found)
+                    result[k] = 0;
+            }
+        }
+    }
+}
+
+QVector<QPair<int, int>> ImageAlgorithms::rowBands(int height) {
+    int band_count = std::max(1, std::min(height, QThread::idealThreadCount() * 4));
+    QVector<QPair<int, int>> bands;
+    for (int i = 0; i < band_count; i++) {
+        bands.append(qMakePair(height * i / band_count, height * (i + 1) / band_count));
+    }
+    return bands;
+}
+
+QVector<float> ImageAlgorithms::grayPlane(const QImage &image) {
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    QVector<float> plane(rgb.width() * rgb.height());
+    for (int y = 0; y < rgb.height(); y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y));
+        float *plane_line = plane.data() + y * rgb.width();
+        for (int x = 0; x < rgb.width(); x++) {
+            plane_line[x] = (qRed(line[x]) + qGreen(line[x]) + qBlue(line[x])) / 3.0f;
+        }
+    }
+    return plane;
+}
+
+QVector<float> ImageAlgorithms::pyramidDown(const QVector<float> &plane, int width, int height) {
+    const float weights[5] = {1 / 16.0f, 4 / 16.0f, 6 / 16.0f, 4 / 16.0f, 1 / 16.0f};
+    int result_width = (width + 1) / 2, result_height = (height + 1) / 2;
+
+    // horizontal pass only on kept columns, vertical pass only on kept rows
+    QVector<float> rows(result_width * height);
+    for (int y = 0; y < height; y++) {
+        const float *line = plane.constData() + y * width;
+        for (int x = 0; x < result_width; x++) {
+            float sum = 0;
+            for (int k = -2; k <= 2; k++) {
+                sum += weights[k + 2] * line[std::min(std::max(2 * x + k, 0), width - 1)];
+            }
+            rows[y * result_width + x] = sum;
+        }
+    }
+
+    QVector<float> result(result_width * result_height, 0);
+    for (int y = 0; y < result_height; y++) {
+        float *out = result.data() + y * result_width;
+        for (int k = -2; k <= 2; k++) {
+            const float *line = rows.constData() + std::min(std::max(2 * y + k, 0), height - 1) * result_width;
+            for (int x = 0; x < result_width; x++) {
+                out[x] += weights[k + 2] * line[x];
+            }
+        }
+    }
+    return result;
+}
+
+void ImageAlgorithms::convolvePlane(const float *plane, int width, int height, const double *matrix, int size, float *result) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double sum = 0;
+            for (int j = 0; j < size; j++) {
+                const float *line = plane + std::min(std::max(y + j - size / 2, 0), height - 1) * width;
+                for (int i = 0; i < size; i++) {
+                    sum += line[std::min(std::max(x + i - size / 2, 0), width - 1)] * matrix[j * size + i];
+                }
+            }
+            result[y * width + x] = sum;
+        }
+    }
+}
+
+QImage ImageAlgorithms::recursiveGaussian(const QImage &image, double sigma) {
+    // I. T. Young, L. J. van Vliet, "Recursive implementation of the Gaussian filter", 1995
+    // third order causal pass followed by anticausal one along rows, then along columns
+    // largest difference of impulse response from sampled gaussian, relative to its peak:
+    // 8% at sigma 1.4, 5% at sigma 2.5, 3% at sigma 5, 2% at sigma 10, so it is meant for large sigma;
+    // tails are not truncated, unlike direct mode with kernel size below 6 sigma
+    sigma = std::max(sigma, 0.5);
+    double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1 - 0.26891 * sigma);
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+    double b1 = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+    double b2 = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+    double b3 = (0.422205 * q * q * q) / b0;
+    double B = 1 - (b1 + b2 + b3);
+
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    int width = rgb.width(), height = rgb.height();
+    QVector<float> plane(width * height * 3);
+    for (int y = 0; y < height; y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y));
+        float *plane_line = plane.data() + y * width * 3;
+        for (int x = 0; x < width; x++) {
+            plane_line[x * 3] = qRed(line[x]);
+            plane_line[x * 3 + 1] = qGreen(line[x]);
+            plane_line[x * 3 + 2] = qBlue(line[x]);
+        }
+    }
+
+    // filters count values of one channel placed with stride, borders are extended by edge value
+    QVector<double> buf(std::max(width, height));
+    auto filterLine {
+        [&](float *data, int count, int stride) {
+            double w1 = data[0], w2 = w1, w3 = w1;
+            for (int i = 0; i < count; i++) {
+                double w = B * data[i * stride] + b1 * w1 + b2 * w2 + b3 * w3;
+                buf[i] = w;
+                w3 = w2; w2 = w1; w1 = w;
+            }
+            double y1 = buf[count - 1], y2 = y1, y3 = y1;
+            for (int i = count - 1; i >= 0; i--) {
+                double v = B * buf[i] + b1 * y1 + b2 * y2 + b3 * y3;
+                data[i * stride] = v;
+                y3 = y2; y2 = y1; y1 = v;
+            }
+        }
+    };
+
+    for (int y = 0; y < height; y++) {
+        for (int c = 0; c < 3; c++) {
+            filterLine(plane.data() + y * width * 3 + c, width, 3);
+        }
+    }
+    for (int x = 0; x < width; x++) {
+        for (int c = 0; c < 3; c++) {
+            filterLine(plane.data() + x * 3 + c, height, width * 3);
+        }
+    }
+
+    QImage result(width, height, QImage::Format_RGB32);
+    auto toByte {
+        [](float v) {
+            return (int)std::min(255.0f, std::max(0.0f, v + 0.5f));
+        }
+    };
+    for (int y = 0; y < height; y++) {
+        QRgb *line = reinterpret_cast<QRgb*>(result.scanLine(y));
+        const float *plane_line = plane.constData() + y * width * 3;
+        for (int x = 0; x < width; x++) {
+            line[x] = qRgb(toByte(plane_line[x * 3]), toByte(plane_line[x * 3 + 1]), toByte(plane_line[x * 3 + 2]));
+        }
+    }
+    return result;
+}
+
+// box of radius r over columns of byte plane, every byte column is an independent channel
+// inner loops go along rows, so they are vectorized by compiler
+static void boxBlurColumns(uchar *data, int width, int height, int r) {
+    QVector<quint32> acc(width);
+    QVector<uchar> source(data, data + width * height);
+    const uchar *src = source.constData();
+    // fixed point reciprocal of box width instead of division
+    quint32 window = 2 * r + 1;
+    quint32 scale = ((1u << 16) + window / 2) / window;
+
+    for (int x = 0; x < width; x++) {
+        acc[x] = (r + 1) * src[x];
+    }
+    for (int k = 1; k <= r; k++) {
+        const uchar *line = src + std::min(k, height - 1) * width;
+        for (int x = 0; x < width; x++) {
+            acc[x] += line[x];
+        }
+    }
+
+    for (int y = 0; y < height; y++) {
+        uchar *out = data + y * width;
+        for (int x = 0; x < width; x++) {
+            out[x] = (acc[x] * scale + (1u << 15)) >> 16;
+        }
+        // borders are extended by edge rows
+        const uchar *add = src + std::min(y + r + 1, height - 1) * width;
+        const uchar *sub = src + std::max(y - r, 0) * width;
+        for (int x = 0; x < width; x++) {
+            acc[x] += add[x] - sub[x];
+        }
+    }
+}
+
+QImage ImageAlgorithms::boxGaussian(const QImage &image, double sigma) {
+    // W. M. Wells, "Efficient synthesis of Gaussian filters by cascaded uniform filters", 1986
+    // n boxes of width w have variance n * (w * w - 1) / 12, odd widths wl and wl + 2 are mixed
+    // so their total variance is the nearest to sigma^2
+    const int n = 3;
+    double w_ideal = sqrt(12 * sigma * sigma / n + 1);
+    int wl = (int)floor(w_ideal);
+    if (wl % 2 == 0) wl--;
+    wl = std::max(wl, 1);
+    int m = (int)round((12 * sigma * sigma - n * wl * wl - 4 * n * wl - 3 * n) / (-4 * wl - 4));
+    int radius[n];
+    for (int i = 0; i < n; i++) {
+        radius[i] = (i < m ? wl : wl + 2) / 2;
+    }
+
+    // vertical passes on rows of pixels as bytes, horizontal ones on transposed image
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    int width = rgb.width(), height = rgb.height();
+    QVector<uchar> plane(width * height * 4);
+    for (int y = 0; y < height; y++) {
+        memcpy(plane.data() + y * width * 4, rgb.constScanLine(y), width * 4);
+    }
+    auto transpose {
+        [](const QVector<uchar> &source, int width, int height) {
+            QVector<uchar> result(source.count());
+            const quint32 *src = reinterpret_cast<const quint32*>(source.constData());
+            quint32 *dst = reinterpret_cast<quint32*>(result.data());
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    dst[x * height + y] = src[y * width + x];
+                }
+            }
+            return result;
+        }
+    };
+
+    for (int i = 0; i < n; i++) {
+        boxBlurColumns(plane.data(), width * 4, height, radius[i]);
+    }
+    plane = transpose(plane, width, height);
+    for (int i = 0; i < n; i++) {
+        boxBlurColumns(plane.data(), height * 4, width, radius[i]);
+    }
+    plane = transpose(plane, height, width);
+
+    QImage result(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; y++) {
+        memcpy(result.scanLine(y), plane.constData() + y * width * 4, width * 4);
+    }
+    return result;
+}
+
+QVector<uchar> ImageAlgorithms::foregroundPlane(const QImage &image) {
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    QVector<uchar> plane(rgb.width() * rgb.height());
+    for (int y = 0; y < rgb.height(); y++) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y));
+        uchar *plane_line = plane.data() + y * rgb.width();
+        for (int x = 0; x < rgb.width(); x++) {
+            plane_line[x] = (line[x] & 0x00ffffff) != 0; // max(r, g, b) > 0
+        }
+    }
+    return plane;
+}
+
+QVector<uchar> ImageAlgorithms::neighbourMask(const QVector<uchar> &plane, int width, int height) {
+    QVector<uchar> mask(width * height, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uchar bits = 0;
+            for (int k = 0; k < 8; k++) {
+                int nx = x + ChainCode::dx[k], ny = y + ChainCode::dy[k];
+                if (nx >= 0 && ny >= 0 && nx < width && ny < height && plane[ny * width + nx])
+                    bits |= 1 << k;
+            }
+            mask[y * width + x] = bits;
+        }
+    }
+    return mask;
+}
+
+
+// weight 0..256, two channels of each pair share one 32 bit multiplication
+static inline QRgb lerpColor(QRgb a, QRgb b, int weight) {
+    quint32 rb = (((a & 0xff00ff) * (256 - weight) + (b & 0xff00ff) * weight) >> 8) & 0xff00ff;
+    quint32 ag = (((a >> 8) & 0xff00ff) * (256 - weight) + ((b >> 8) & 0xff00ff) * weight) & 0xff00ff00;
+    return rb | ag;
+}
+
+QImage ImageAlgorithms::warpPerspective(const QImage &image, const QTransform &target_to_source, QRgb background) {
+    QImage source = image.convertToFormat(QImage::Format_RGB32);
+    int width = source.width(), height = source.height();
+    if (width < 2 || height < 2)
+        return source;
+
+    QImage result(width, height, QImage::Format_RGB32);
+    const uchar *source_bits = source.constBits();
+    uchar *result_bits = result.bits();
+    qsizetype source_bpl = source.bytesPerLine(), result_bpl = result.bytesPerLine();
+    const QTransform &t = target_to_source;
+
+    QtConcurrent::blockingMap(rowBands(height), [&](const QPair<int, int> &band) {
+        QVector<float> xs(width), ys(width);
+        for (int y = band.first; y < band.second; y++) {
+            // numerators and denominator are linear along row, so source positions are a division loop the compiler vectorizes
+            float nx = t.m21() * y + t.m31(), ny = t.m22() * y + t.m32(), nw = t.m23() * y + t.m33();
+            float dx = t.m11(), dy = t.m12(), dw = t.m13();
+            for (int x = 0; x < width; x++) {
+                float w = nw + dw * x;
+                xs[x] = (nx + dx * x) / w;
+                ys[x] = (ny + dy * x) / w;
+            }
+
+            QRgb *out = reinterpret_cast<QRgb*>(result_bits + y * result_bpl);
+            for (int x = 0; x < width; x++) {
+                float sx = xs[x], sy = ys[x];
+                // also catches nan of points mapped to infinity
+                if (! (sx >= 0 && sy >= 0 && sx <= width - 1 && sy <= height - 1)) {
+                    out[x] = background;
+                    continue;
+                }
+                int x0 = std::min((int)sx, width - 2), y0 = std::min((int)sy, height - 2);
+                int wx = (int)((sx - x0) * 256), wy = (int)((sy - y0) * 256);
+                const QRgb *top = reinterpret_cast<const QRgb*>(source_bits + y0 * source_bpl) + x0;
+                const QRgb *bottom = reinterpret_cast<const QRgb*>(source_bits + (y0 + 1) * source_bpl) + x0;
+                out[x] = lerpColor(lerpColor(top[0], top[1], wx), lerpColor(bottom[0], bottom[1], wx), wy);
+            }
+        }
+    });
+    return result;
+}
+
 
 double MathFunctions::gaussian2d(double x, double y, double sigma) {
     return 1 / (2 * M_PI * sigma * sigma) * exp(-(x * x + y * y) / (2 * sigma * sigma));
@@ -4,27 +4,52 @@
 #include <cmath>
 #include <algorithm>
 #include <QImage>
+#include <QVector>
+#include <QPair>
+#include <QTransform>
 
-class GradientVector {
-private:
-    QPoint rot;
-    QPointF vec;
-
-public:
-    QPoint getRotation() { return rot; }
-    QPointF getVec() { return vec; }
-    void set(double x, double y) {
-        vec.setX(x);
-        vec.setY(y);
-        rot.setX(fabs(x) > std::max(x, y) * 0.3827 ? (x < 0 ? -1 : 1) : 0);
-        rot.setY(fabs(y) > std::max(x, y) * 0.3827 ? (y < 0 ? -1 : 1) : 0);
-    }
-    double len() { return fabs(vec.x()) + fabs(vec.y()); }
-};
+// Freeman chain code directions, y axis looks down: 0 - east, 2 - north, 4 - west, 6 - south
+namespace ChainCode {
+    const int dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+    const int dy[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+}
 
 namespace ImageAlgorithms {
-    QImage convolving(const QImage &image, double **matrix, int size);
-    void convolving(double **val, int width, int height, const QImage &image, double *matrix, int size);
+    QImage convolving(const QImage &image, const double * const *matrix, int size);
+    void convolving(double **val, int width, int height, const QImage &image, const double *matrix, int size);
+    // Young - van Vliet recursive gaussian, cost per pixel does not depend on sigma
+    QImage recursiveGaussian(const QImage &image, double sigma);
+    // three box blurs with widths matching gaussian variance, running sums in integers
+    QImage boxGaussian(const QImage &image, double sigma);
+
+    // magnitude |gx| + |gy| and orientation bin of gradient, row by row
+    // bins: 0 - horizontal, 1 - diagonal down right, 2 - vertical, 3 - diagonal down left
+    // image version convolves mean of color channels with size x size kernels in row bands
+    void gradientPlanes(const QImage &image, const double *matrix_x, const double *matrix_y, int size, quint16 *magnitude, uchar *orientation);
+    void gradientPlanes(const float *values_x, const float *values_y, int count, quint16 *magnitude, uchar *orientation);
+    // clears magnitudes which are not greater than both neighbours across the edge, border is cleared
+    void nonMaximumSuppression(const quint16 *magnitude, const uchar *orientation, int width, int height, quint16 *result);
+    // 0 - no edge, 1 - weak edge, 2 - strong edge; with hysteresis weak edges not touching strong ones are dropped
+    void hysteresisThreshold(const quint16 *magnitude, int width, int height, int low, int high, bool hysteresis, uchar *result);
+
+    // [begin, end) row ranges for parallel processing, several per thread to balance load
+    QVector<QPair<int, int>> rowBands(int height);
+
+    // mean of color channels, row by row
+    QVector<float> grayPlane(const QImage &image);
+    // 5 tap binomial blur and subsampling by 2, result has (width + 1) / 2 x (height + 1) / 2 size
+    QVector<float> pyramidDown(const QVector<float> &plane, int width, int height);
+    // size x size kernel over plane, borders are extended by edge value
+    void convolvePlane(const float *plane, int width, int height, const double *matrix, int size, float *result);
+
+    // 1 for pixels with non zero color value, row by row
+    QVector<uchar> foregroundPlane(const QImage &image);
+    // bit k is set when neighbour in chain code direction k is foreground
+    QVector<uchar> neighbourMask(const QVector<uchar> &plane, int width, int height);
+
+    // image of the same size, pixel is bilinear sample of image at position given by target_to_source
+    // positions outside image get background color
+    QImage warpPerspective(const QImage &image, const QTransform &target_to_source, QRgb background);
 }
 
 namespace MathFunctions {
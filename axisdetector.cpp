@@ -0,0 +1,172 @@
+#include "axisdetector.h"
+
+static const double angle_step = 0.25 * M_PI / 180;
+static const double min_line_ratio = 0.2; // of image side, weaker families are not lines
+static const double grid_ratio = 0.4; // of strongest line in family
+static const double axis_ratio = 0.8;
+static const int peak_radius = 4;
+
+struct AngleBin {
+    double theta;
+    bool horizontal;
+    QVector<int> votes;
+};
+
+// threshold between dark and light pixels by Otsu method
+static float darkThreshold(const QVector<float> &gray) {
+    QVector<qint64> histogram(256, 0);
+    for (float v : gray) {
+        histogram[std::min(std::max((int)v, 0), 255)]++;
+    }
+
+    qint64 total = gray.count(), dark_count = 0;
+    double sum = 0, dark_sum = 0;
+    for (int i = 0; i < 256; i++) sum += (double)i * histogram[i];
+    double best = -1;
+    int threshold = 128;
+    for (int t = 0; t < 256; t++) {
+        dark_count += histogram[t];
+        dark_sum += (double)t * histogram[t];
+        if (dark_count == 0 || dark_count == total)
+            continue;
+        double dark_mean = dark_sum / dark_count, light_mean = (sum - dark_sum) / (total - dark_count);
+        double between = (double)dark_count * (total - dark_count) * (dark_mean - light_mean) * (dark_mean - light_mean);
+        if (between > best) {
+            best = between;
+            threshold = t;
+        }
+    }
+    return threshold + 0.5f;
+}
+
+// local maxima not weaker than min_votes, stronger one wins inside peak_radius
+static QVector<int> findPeaks(const QVector<int> &votes, int min_votes) {
+    QVector<int> peaks;
+    for (int r = 0; r < votes.count(); r++) {
+        if (votes[r] < min_votes)
+            continue;
+        bool is_max = true;
+        for (int k = std::max(r - peak_radius, 0); k <= std::min(r + peak_radius, votes.count() - 1) && is_max; k++) {
+            // plateau keeps its first bin
+            is_max = votes[k] < votes[r] || (votes[k] == votes[r] && k >= r);
+        }
+        if (is_max)
+            peaks.append(r);
+    }
+    return peaks;
+}
+
+AxisEstimate AxisDetector::detect(const QImage &image, double max_skew) {
+    AxisEstimate estimate;
+    if (image.isNull())
+        return estimate;
+
+    int width = image.width(), height = image.height();
+    QVector<float> gray = ImageAlgorithms::grayPlane(image);
+    float threshold = darkThreshold(gray);
+
+    QVector<float> xs, ys;
+    for (int y = 0; y < height; y++) {
+        const float *line = gray.constData() + y * width;
+        for (int x = 0; x < width; x++) {
+            if (line[x] < threshold) {
+                xs.append(x);
+                ys.append(y);
+            }
+        }
+    }
+    // dark background or empty image has no dark lines to follow
+    if (xs.isEmpty() || xs.count() > (qint64)width * height / 2)
+        return estimate;
+
+    int offset = (int)ceil(sqrt((double)width * width + (double)height * height));
+    int angle_steps = std::max(0, (int)(max_skew * M_PI / 180 / angle_step)); // bins on each side of 0 and 90 degrees
+    QVector<AngleBin> bins;
+    for (int family = 0; family < 2; family++) {
+        for (int k = -angle_steps; k <= angle_steps; k++) {
+            bins.append({(family == 1 ? M_PI / 2 : 0) + k * angle_step, family == 1, QVector<int>(offset * 2 + 1, 0)});
+        }
+    }
+
+    // rho of chunk is computed in a plain loop the compiler vectorizes, votes are added after it
+    int count = xs.count();
+    QtConcurrent::blockingMap(bins, [&](AngleBin &bin) {
+        const int chunk = 1024;
+        int rho[chunk];
+        float c = cos(bin.theta), s = sin(bin.theta), shift = offset + 0.5f;
+        const float *px = xs.constData(), *py = ys.constData();
+        int *votes = bin.votes.data();
+        for (int start = 0; start < count; start += chunk) {
+            int n = std::min(chunk, count - start);
+            for (int i = 0; i < n; i++) {
+                rho[i] = (int)(px[start + i] * c + py[start + i] * s + shift);
+            }
+            for (int i = 0; i < n; i++) {
+                votes[rho[i]]++;
+            }
+        }
+    });
+
+    // angle with strongest line is the skew of family, its lines give axis and grid spacing
+    double thetas[2] = {0, M_PI / 2}, rhos[2] = {0, 0};
+    bool found[2] = {false, false};
+    int pps[2] = {0, 0};
+    for (int family = 0; family < 2; family++) {
+        const AngleBin *best = nullptr;
+        int best_votes = 0;
+        for (const AngleBin &bin : bins) {
+            if (bin.horizontal != (family == 1))
+                continue;
+            int votes = *std::max_element(bin.votes.begin(), bin.votes.end());
+            if (votes > best_votes) {
+                best_votes = votes;
+                best = &bin;
+            }
+        }
+        int side = family == 1 ? width : height;
+        if (best == nullptr || best_votes < side * min_line_ratio)
+            continue;
+
+        QVector<int> peaks = findPeaks(best->votes, std::max(1, (int)(best_votes * grid_ratio)));
+
+        // plot frame has two strong lines, axes are at left and bottom
+        int axis = -1;
+        for (int r : peaks) {
+            if (best->votes[r] >= best_votes * axis_ratio && (axis < 0 || (family == 0 ? r < axis : r > axis)))
+                axis = r;
+        }
+        found[family] = true;
+        thetas[family] = best->theta;
+        rhos[family] = axis - offset;
+
+        QVector<int> spacings;
+        for (int i = 1; i < peaks.count(); i++) {
+            spacings.append(peaks[i] - peaks[i - 1]);
+        }
+        if (! spacings.isEmpty()) {
+            std::nth_element(spacings.begin(), spacings.begin() + spacings.count() / 2, spacings.end());
+            pps[family] = spacings[spacings.count() / 2];
+        }
+    }
+
+    // origin is intersection of axes, single axis is taken in the middle of image
+    double c0 = cos(thetas[0]), s0 = sin(thetas[0]), c1 = cos(thetas[1]), s1 = sin(thetas[1]);
+    if (found[0] && found[1]) {
+        double det = c0 * s1 - s0 * c1;
+        estimate.start_pixel_x = lround((rhos[0] * s1 - rhos[1] * s0) / det);
+        estimate.start_pixel_y = lround((c0 * rhos[1] - c1 * rhos[0]) / det);
+    }
+    else if (found[0]) {
+        estimate.start_pixel_x = lround((rhos[0] - height / 2.0 * s0) / c0);
+    }
+    else if (found[1]) {
+        estimate.start_pixel_y = lround((rhos[1] - width / 2.0 * c1) / s1);
+    }
+    estimate.y_axis_found = found[0];
+    estimate.x_axis_found = found[1];
+    estimate.pps_x = pps[0];
+    estimate.pps_y = pps[1];
+    estimate.row_angle = thetas[1] - M_PI / 2;
+    estimate.column_angle = thetas[0];
+    return estimate;
+}
@@ -0,0 +1,30 @@
+#ifndef AXISDETECTOR_H
+#define AXISDETECTOR_H
+
+#include <QImage>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <cmath>
+
+#include "algorithms.h"
+
+// axes origin and grid spacing found in image, values are in image pixels
+struct AxisEstimate {
+    bool x_axis_found = false, y_axis_found = false;
+    int start_pixel_x = 0; // column of y axis
+    int start_pixel_y = 0; // row of x axis
+    int pps_x = 0, pps_y = 0; // 0 when less than two grid lines are found
+    // turn of found lines in radians, rows and columns of image are 0
+    double row_angle = 0, column_angle = 0;
+};
+
+// dominant horizontal and vertical lines by Hough transform over dark pixels
+// only angles within max_skew degrees of 0 and 90 are voted, every angle bin is accumulated on its own worker
+// axes are the leftmost and lowest of strongest lines, pixels per step is the median spacing of parallel lines
+// safe to call from worker threads
+namespace AxisDetector {
+    AxisEstimate detect(const QImage &image, double max_skew = 2);
+}
+
+#endif // AXISDETECTOR_H
@@ -0,0 +1,147 @@
+#include "dataexport.h"
+
+static const int flush_size = 1 << 20;
+
+// receives contours in graph units and writes them into file
+class ContourSink {
+public:
+    virtual ~ContourSink() {}
+
+    virtual bool open() = 0;
+    virtual void addContour(const QPolygonF &contour) = 0;
+    virtual bool finish() = 0;
+};
+
+// contours written as text, buffer goes to file each time it grows over flush_size
+class TextContourSink : public ContourSink {
+private:
+    QSaveFile file;
+    DataExport::Format format;
+    QByteArray buffer;
+    int contour_index = 0;
+    bool failed = false;
+
+    void flush() {
+        if (! failed && ! buffer.isEmpty())
+            failed = file.write(buffer) != buffer.size();
+        buffer.clear();
+    }
+
+    void appendNumber(double value) {
+        buffer += QByteArray::number(value, 'g', 10);
+    }
+
+public:
+    TextContourSink(const QString &filename, DataExport::Format format) : file(filename) {
+        this->format = format;
+        buffer.reserve(flush_size + 4096);
+    }
+
+    bool open() {
+        failed = ! file.open(QIODevice::WriteOnly);
+        buffer += format == DataExport::Csv ? "contour,x,y\n" : "{\"contours\": [";
+        return ! failed;
+    }
+
+    void addContour(const QPolygonF &contour) {
+        if (format == DataExport::Csv) {
+            QByteArray index = QByteArray::number(contour_index) + ",";
+            for (const QPointF &point : contour) {
+                buffer += index;
+                appendNumber(point.x());
+                buffer += ",";
+                appendNumber(point.y());
+                buffer += "\n";
+                if (buffer.size() > flush_size)
+                    flush();
+            }
+        }
+        else {
+            buffer += contour_index > 0 ? ",\n[" : "\n[";
+            for (int i = 0; i < contour.count(); i++) {
+                buffer += i > 0 ? ", [" : "[";
+                appendNumber(contour[i].x());
+                buffer += ", ";
+                appendNumber(contour[i].y());
+                buffer += "]";
+                if (buffer.size() > flush_size)
+                    flush();
+            }
+            buffer += "]";
+        }
+        contour_index++;
+    }
+
+    bool finish() {
+        if (format == DataExport::Json)
+            buffer += "\n]}\n";
+        flush();
+        if (failed) {
+            file.cancelWriting();
+            return false;
+        }
+        return file.commit();
+    }
+};
+
+class VectorContourSink : public ContourSink {
+private:
+    VectorFileWriter writer;
+
+public:
+    explicit VectorContourSink(const QString &filename) : writer(filename, VectorFormat::FloatPoints) {}
+
+    bool open() { return writer.open(); }
+    void addContour(const QPolygonF &contour) { writer.addContour(contour); }
+    bool finish() { return writer.finish(); }
+};
+
+static ContourSink* createSink(const QString &filename, DataExport::Format format) {
+    if (format == DataExport::Vectors)
+        return new VectorContourSink(filename);
+    return new TextContourSink(filename, format);
+}
+
+static QPolygonF toGraph(const QLinkedList<QPoint> &contour, const GraphTransform &graph_transform) {
+    QPolygonF result;
+    result.reserve(contour.count());
+    for (const QPoint &point : contour) {
+        result.append(graph_transform.toGraph(point));
+    }
+    return result;
+}
+
+bool DataExport::exportProduct(const QString &filename, Format format, const VectorizationProduct &product, const GraphTransform &graph_transform) {
+    QScopedPointer<ContourSink> sink(createSink(filename, format));
+    if (! sink->open())
+        return false;
+    for (auto it = product.begin(); it != product.end(); it++) {
+        sink->addContour(toGraph(*it, graph_transform));
+    }
+    return sink->finish();
+}
+
+bool DataExport::exportGraph(const QString &filename, Format format, const VectorizationProductGraph &graph, const GraphTransform &graph_transform) {
+    QScopedPointer<ContourSink> sink(createSink(filename, format));
+    if (! sink->open())
+        return false;
+    graph.forEachBranch([&](const QLinkedList<QPoint> &branch) {
+        sink->addContour(toGraph(branch, graph_transform));
+    });
+    return sink->finish();
+}
+
+bool DataExport::exportSamples(const QString &filename, Format format, const ResampledCurves &samples) {
+    QScopedPointer<ContourSink> sink(createSink(filename, format));
+    if (! sink->open())
+        return false;
+    for (int p = 0; p < samples.pieceCount(); p++) {
+        QPolygonF piece;
+        piece.reserve(samples.offsets[p + 1] - samples.offsets[p]);
+        for (int i = samples.offsets[p]; i < samples.offsets[p + 1]; i++) {
+            piece.append(QPointF(samples.x[i], samples.y[i]));
+        }
+        sink->addContour(piece);
+    }
+    return sink->finish();
+}
@@ -0,0 +1,29 @@
+#ifndef DATAEXPORT_H
+#define DATAEXPORT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QSaveFile>
+#include <QPolygonF>
+#include <QScopedPointer>
+
+#include "graphpreprocess.h"
+#include "vectorfile.h"
+
+// export of vectorization results in graph units
+// contours are converted and written one by one through a buffer, so memory use does not depend on point count
+// functions are safe to call from worker threads
+namespace DataExport {
+    enum Format {
+        Csv, // contour,x,y rows
+        Json, // {"contours": [[[x, y], ...], ...]}
+        Vectors // vector file with float points
+    };
+
+    bool exportProduct(const QString &filename, Format format, const VectorizationProduct &product, const GraphTransform &graph_transform);
+    bool exportGraph(const QString &filename, Format format, const VectorizationProductGraph &graph, const GraphTransform &graph_transform);
+    // pieces of resampling stage, already in graph units
+    bool exportSamples(const QString &filename, Format format, const ResampledCurves &samples);
+}
+
+#endif // DATAEXPORT_H
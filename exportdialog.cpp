@@ -8,9 +8,12 @@ ExportDialog::ExportDialog(QWidget *parent) : QDialog(parent), ui(new Ui::Export
 
     connect(ui->buttonSaveImage, SIGNAL(clicked()), this, SLOT(saveImage()));
     connect(ui->spinImageCrop, SIGNAL(valueChanged(int)), this, SLOT(cropWidth(int)));
+    connect(ui->buttonSaveData, SIGNAL(clicked()), this, SLOT(saveData()));
+    connect(&data_watcher, &QFutureWatcher<bool>::finished, this, &ExportDialog::onDataSaved);
 }
 
 ExportDialog::~ExportDialog() {
+    data_watcher.waitForFinished();
     delete ui;
 }
 
@@ -33,6 +36,33 @@ void ExportDialog::setExportImage(const QImage &export_image) {
     }
 }
 
+void ExportDialog::setExportGraph(VectorizationResult result, VectorizationResultGraph result_graph, const GraphTransform &graph_transform) {
+    export_result = result;
+    export_result_graph = result_graph;
+    export_transform = graph_transform;
+
+    if (! export_result.isNull()) {
+        qint64 point_count = 0;
+        for (auto it = export_result->begin(); it != export_result->end(); it++) {
+            point_count += it->count();
+        }
+        ui->labelGraphInfo->setText(QString("%1 contours, %2 points").arg(export_result->count()).arg(point_count));
+    }
+    else if (! export_result_graph.isNull()) {
+        ui->labelGraphInfo->setText(QString("%1 graphs, %2 nodes").arg(export_result_graph->rootCount()).arg(export_result_graph->nodeCount()));
+    }
+    else {
+        ui->labelGraphInfo->setText("Graph not found (generate it previously)");
+    }
+}
+
+void ExportDialog::setExportSamples(ResampledResult samples) {
+    export_samples = samples;
+    if (! export_samples.isNull()) {
+        ui->labelGraphInfo->setText(QString("%1 pieces, %2 samples with x step %3").arg(export_samples->pieceCount()).arg(export_samples->x.count()).arg(export_samples->step));
+    }
+}
+
 void ExportDialog::updatePreview() {
     int crop_width = ui->spinImageCrop->value();
     if (! export_image.isNull())
@@ -64,3 +94,40 @@ void ExportDialog::cropWidth(int crop_width) {
     this->crop_width = crop_width;
     updatePreview();
 }
+
+void ExportDialog::saveData() {
+    if (export_result.isNull() && export_result_graph.isNull()) {
+        QMessageBox::warning(this, "Save Data", "Graph not found (generate it previously)");
+        return;
+    }
+
+    DataExport::Format format = (DataExport::Format)ui->comboDataFormat->currentIndex();
+    QString filter = format == DataExport::Csv ? "CSV Files(*.csv)" : format == DataExport::Json ? "JSON Files(*.json)" : "Vector Files(*.gvv)";
+    QString filename = QFileDialog::getSaveFileName(this, "Save Data", "/", filter);
+    if (filename == "")
+        return;
+
+    // results are shared with worker, points are written while dialog stays responsive
+    VectorizationResult result = export_result;
+    VectorizationResultGraph result_graph = export_result_graph;
+    ResampledResult samples = export_samples;
+    GraphTransform graph_transform = export_transform;
+    ui->buttonSaveData->setDisabled(true);
+    data_watcher.setFuture(QtConcurrent::run([=]() {
+        if (! samples.isNull())
+            return DataExport::exportSamples(filename, format, *samples);
+        if (! result.isNull())
+            return DataExport::exportProduct(filename, format, *result, graph_transform);
+        return DataExport::exportGraph(filename, format, *result_graph, graph_transform);
+    }));
+}
+
+void ExportDialog::onDataSaved() {
+    ui->buttonSaveData->setDisabled(false);
+    if (data_watcher.result()) {
+        accept();
+    }
+    else {
+        QMessageBox::warning(this, "Save Data", "Export data failed");
+    }
+}
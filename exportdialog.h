@@ -9,6 +9,10 @@
 #include <QGraphicsView>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsScene>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include "dataexport.h"
 
 namespace Ui {
     class ExportDialog;
@@ -22,6 +26,10 @@ public:
     ~ExportDialog();
 
     void setExportImage(const QImage &export_image);
+    // either result is null, depending on graph mode
+    void setExportGraph(VectorizationResult result, VectorizationResultGraph result_graph, const GraphTransform &graph_transform);
+    // samples of resampling stage are exported instead of contours when present
+    void setExportSamples(ResampledResult samples);
 
 private:
     Ui::ExportDialog *ui;
@@ -31,11 +39,19 @@ private:
 
     int crop_width;
 
+    VectorizationResult export_result;
+    VectorizationResultGraph export_result_graph;
+    GraphTransform export_transform;
+    ResampledResult export_samples;
+    QFutureWatcher<bool> data_watcher;
+
 protected:
     void updatePreview();
 
 public slots:
     void saveImage();
+    void saveData();
+    void onDataSaved();
 
     void cropWidth(int crop_width);
 };
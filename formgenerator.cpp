@@ -55,9 +55,17 @@ void FormGenerator::generateWidget(QWidget *parent_widget, QFormLayout *layout,
                 }
                 else {
                     QLineEdit *line = new QLineEdit(parent_widget);
+                    line->setText(prop_val.toString());
                     connect(line, &QLineEdit::textChanged, this, [=](const QString &val) {
                         this->setProperty(prop_elem["name"].toString().toStdString().c_str(), val);
                     });
+                    // text follows values set from code
+                    QMetaProperty meta_prop = metaObject()->property(metaObject()->indexOfProperty(prop_elem["name"].toString().toStdString().c_str()));
+                    if (meta_prop.hasNotifySignal()) {
+                        LineEditSync *sync = new LineEditSync(line);
+                        connect(this, meta_prop.notifySignal(), sync, sync->metaObject()->method(sync->metaObject()->indexOfSlot("setText(QString)")));
+                    }
+                    field = line;
                 }
             }
         }
@@ -28,6 +28,24 @@
 
 #include <QDebug>
 
+// sets text of line edit only when it differs, so echo of user's own edit keeps cursor and undo history
+// lives with the line edit, notify signals found by meta property can not be connected to a lambda
+class LineEditSync : public QObject {
+    Q_OBJECT
+
+private:
+    QLineEdit *line;
+
+public:
+    explicit LineEditSync(QLineEdit *line) : QObject(line), line(line) {}
+
+public slots:
+    void setText(const QString &text) {
+        if (line->text() != text)
+            line->setText(text);
+    }
+};
+
 class FormGenerator : public QObject {
     Q_OBJECT
 
@@ -1,4 +1,4 @@
-QT       += core core5compat gui charts
+QT       += core core5compat gui charts concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -11,27 +11,45 @@ CONFIG += c++11
 SOURCES += \
     aboutdialog.cpp \
     algorithms.cpp \
+    axisdetector.cpp \
+    dataexport.cpp \
     exportdialog.cpp \
     formgenerator.cpp \
+    graphchart.cpp \
     graphpreprocess.cpp \
     imageaxis.cpp \
+    imageloader.cpp \
+    imageplane.cpp \
     imagepoint.cpp \
     imagepreprocess.cpp \
     imageview.cpp \
+    kernels.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    resultcache.cpp \
+    tiledimageitem.cpp \
+    vectorfile.cpp
 
 HEADERS += \
     aboutdialog.h \
     algorithms.h \
+    axisdetector.h \
+    dataexport.h \
     exportdialog.h \
     formgenerator.h \
+    graphchart.h \
     graphpreprocess.h \
     imageaxis.h \
+    imageloader.h \
+    imageplane.h \
     imagepoint.h \
     imagepreprocess.h \
     imageview.h \
-    mainwindow.h
+    kernels.h \
+    mainwindow.h \
+    resultcache.h \
+    tiledimageitem.h \
+    vectorfile.h
 
 FORMS += \
     aboutdialog.ui \
@@ -0,0 +1,328 @@
+#include "graphchart.h"
+
+#include <algorithm>
+
+QPolygonF ContourLod::decimate(const QPolygonF &contour, double x_origin, double bucket) {
+    QPolygonF result;
+    int count = contour.count();
+    int i = 0;
+    while (i < count) {
+        double b = floor((contour[i].x() - x_origin) / bucket);
+        int j = i, min_i = i, max_i = i;
+        while (j + 1 < count && floor((contour[j + 1].x() - x_origin) / bucket) == b) {
+            j++;
+            if (contour[j].y() < contour[min_i].y()) min_i = j;
+            if (contour[j].y() > contour[max_i].y()) max_i = j;
+        }
+
+        // keep envelope points in contour order
+        int ids[4] = {i, min_i, max_i, j};
+        std::sort(ids, ids + 4);
+        for (int k = 0; k < 4; k++) {
+            if (k == 0 || ids[k] != ids[k - 1]) result.append(contour[ids[k]]);
+        }
+        i = j + 1;
+    }
+    return result;
+}
+
+void ContourLod::build(const QVector<QPolygonF> &contours, double x_origin, double base_step) {
+    this->x_origin = x_origin;
+    this->base_step = base_step;
+
+    levels.clear();
+    levels.append(contours);
+
+    bounds.clear();
+    bounds.reserve(contours.count());
+    for (const QPolygonF &contour : contours) {
+        bounds.append(contour.boundingRect());
+    }
+
+    // coarser levels are built from previous ones until they stop shrinking
+    int prev_count = -1, cur_count = 0;
+    for (const QPolygonF &contour : contours) cur_count += contour.count();
+    double bucket = base_step;
+    while (cur_count != prev_count && levels.count() < 32) {
+        bucket *= 2;
+        QVector<QPolygonF> next_level;
+        next_level.reserve(contours.count());
+        prev_count = cur_count;
+        cur_count = 0;
+        for (const QPolygonF &contour : levels.last()) {
+            next_level.append(decimate(contour, x_origin, bucket));
+            cur_count += next_level.last().count();
+        }
+        levels.append(next_level);
+    }
+}
+
+int ContourLod::levelFor(double graph_per_pixel) const {
+    int l = 0;
+    double bucket = base_step * 2;
+    while (l + 1 < levels.count() && bucket <= graph_per_pixel) {
+        l++;
+        bucket *= 2;
+    }
+    return l;
+}
+
+QVector<QPolygonF> ContourLod::visible(int l, const QRectF &view) const {
+    QVector<QPolygonF> result;
+    for (int c = 0; c < levels[l].count(); c++) {
+        result += visible(l, view, c);
+    }
+    return result;
+}
+
+QVector<QPolygonF> ContourLod::visible(int l, const QRectF &view, int c) const {
+    QVector<QPolygonF> result;
+    // bounds of straight lines have zero size, so compare ranges directly
+    if (bounds[c].right() < view.left() || bounds[c].left() > view.right() || bounds[c].bottom() < view.top() || bounds[c].top() > view.bottom())
+        return result;
+
+    const QPolygonF &contour = levels[l][c];
+    auto inside {
+        [&](int i) {
+            return i >= 0 && i < contour.count() && contour[i].x() >= view.left() && contour[i].x() <= view.right();
+        }
+    };
+
+    // points next to visible ones are kept, so lines reach view border
+    QPolygonF piece;
+    for (int i = 0; i < contour.count(); i++) {
+        if (inside(i - 1) || inside(i) || inside(i + 1)) {
+            piece.append(contour[i]);
+        }
+        else if (! piece.isEmpty()) {
+            result.append(piece);
+            piece.clear();
+        }
+    }
+    if (! piece.isEmpty())
+        result.append(piece);
+    return result;
+}
+
+
+
+ChartContours GraphChart::prepareContours(const VectorizationProduct &result, const GraphTransform &graph_transform, const QSize &image_size) {
+    ChartContours chart_contours;
+
+    QPointF top_left = graph_transform.toGraph(QPointF(0, 0));
+    QPointF bottom_right = graph_transform.toGraph(QPointF(image_size.width(), image_size.height()));
+    chart_contours.range = QRectF(QPointF(top_left.x(), bottom_right.y()), QPointF(bottom_right.x(), top_left.y()));
+
+    QVector<QPolygonF> contours;
+    contours.reserve(result.count());
+    for (auto it = result.begin(); it != result.end(); it++) {
+        QPolygonF contour;
+        contour.reserve(it->count());
+        for (auto it_2 = it->begin(); it_2 != it->end(); it_2++) {
+            contour.append(graph_transform.toGraph(*it_2));
+        }
+        contours.append(contour);
+    }
+
+    // level 0 bucket is one image pixel
+    chart_contours.lod.build(contours, chart_contours.range.left(), fabs(graph_transform.scaleX()));
+
+    return chart_contours;
+}
+
+double GraphChart::graphPerPixel(QChart *chart, QValueAxis *axis_x) {
+    return chart->plotArea().width() > 0 ? (axis_x->max() - axis_x->min()) / chart->plotArea().width() : 0;
+}
+
+QChart* GraphChart::createChart(const ChartContours &chart_contours, bool batched) {
+    QChart *chart = new QChart();
+
+    QValueAxis *axisX = new QValueAxis();
+    axisX->setTitleText("x");
+    axisX->setLabelFormat("%g");
+    axisX->setTickInterval(100.0);
+    axisX->setTickAnchor(0.0);
+    axisX->setTickType(QValueAxis::TicksDynamic);
+    axisX->setRange(chart_contours.range.left(), chart_contours.range.right());
+
+    QValueAxis *axisY = new QValueAxis();
+    axisY->setTitleText("y");
+    axisY->setLabelFormat("%g");
+    axisY->setTickInterval(100.0);
+    axisY->setTickAnchor(0.0);
+    axisY->setTickType(QValueAxis::TicksDynamic);
+    axisY->setRange(chart_contours.range.top(), chart_contours.range.bottom());
+
+    chart->addAxis(axisX, Qt::AlignBottom);
+    chart->addAxis(axisY, Qt::AlignLeft);
+
+    if (! batched) {
+        // series are filled by controller with level matching current zoom
+        QList<QLineSeries*> series_list;
+        for (int i = 0; i < chart_contours.lod.level(0).count(); i++) {
+            QLineSeries *series = new QLineSeries();
+            chart->addSeries(series);
+            series->attachAxis(axisX);
+            series->attachAxis(axisY);
+            series_list.append(series);
+        }
+        new SeriesLodController(chart, axisX, axisY, series_list, chart_contours.lod);
+    }
+    else {
+        // invisible series keeps axes domain, so rubber band zoom still works
+        QLineSeries *anchor = new QLineSeries();
+        anchor->setPen(Qt::NoPen);
+        *anchor << chart_contours.range.topLeft() << chart_contours.range.bottomRight();
+        chart->addSeries(anchor);
+        anchor->attachAxis(axisX);
+        anchor->attachAxis(axisY);
+        chart->legend()->setVisible(false);
+
+        new ContourBatchItem(chart, axisX, axisY, chart_contours.lod);
+    }
+
+    return chart;
+}
+
+
+
+SeriesLodController::SeriesLodController(QChart *chart, QValueAxis *axis_x, QValueAxis *axis_y, const QList<QLineSeries*> &series, const ContourLod &lod) : QObject(chart) {
+    this->chart = chart;
+    this->axis_x = axis_x;
+    this->axis_y = axis_y;
+    for (QLineSeries *contour_series : series) {
+        this->series.append({contour_series});
+    }
+    this->lod = lod;
+
+    update_timer.setSingleShot(true);
+    update_timer.setInterval(0);
+    connect(&update_timer, &QTimer::timeout, this, &SeriesLodController::updateSeries);
+    connect(chart, &QChart::plotAreaChanged, this, &SeriesLodController::chartChanged);
+    connect(axis_x, &QValueAxis::rangeChanged, this, &SeriesLodController::chartChanged);
+    connect(axis_y, &QValueAxis::rangeChanged, this, &SeriesLodController::chartChanged);
+}
+
+SeriesLodController::~SeriesLodController() {}
+
+QLineSeries* SeriesLodController::pieceSeries(int c, int k) {
+    while (series[c].count() <= k) {
+        QLineSeries *piece_series = new QLineSeries();
+        piece_series->setPen(series[c].first()->pen());
+        chart->addSeries(piece_series);
+        piece_series->attachAxis(axis_x);
+        piece_series->attachAxis(axis_y);
+        // legend keeps one entry per contour
+        for (QLegendMarker *marker : chart->legend()->markers(piece_series)) {
+            marker->setVisible(false);
+        }
+        series[c].append(piece_series);
+    }
+    return series[c][k];
+}
+
+void SeriesLodController::chartChanged() {
+    update_timer.start();
+}
+
+void SeriesLodController::updateSeries() {
+    // series stay empty until chart is laid out and pixel size is known
+    if (chart->plotArea().width() <= 0)
+        return;
+
+    int level = lod.levelFor(GraphChart::graphPerPixel(chart, axis_x));
+    QRectF view(QPointF(axis_x->min(), axis_y->min()), QPointF(axis_x->max(), axis_y->max()));
+    for (int c = 0; c < series.count(); c++) {
+        QVector<QPolygonF> pieces = lod.visible(level, view, c);
+        for (int k = 0; k < pieces.count(); k++) {
+            pieceSeries(c, k)->replace(pieces[k]);
+        }
+        if (pieces.isEmpty() && series[c].first()->count() > 0)
+            series[c].first()->clear();
+        // first series keeps legend entry of contour, extra ones go away with their pieces
+        while (series[c].count() > std::max(1, (int)pieces.count())) {
+            QLineSeries *piece_series = series[c].takeLast();
+            chart->removeSeries(piece_series);
+            delete piece_series;
+        }
+    }
+}
+
+
+
+ContourBatchItem::ContourBatchItem(QChart *chart, QValueAxis *axis_x, QValueAxis *axis_y, const ContourLod &lod) : QGraphicsObject(chart) {
+    this->chart = chart;
+    this->axis_x = axis_x;
+    this->axis_y = axis_y;
+    this->lod = lod;
+    path_outdated = false;
+
+    pen = QPen(QColor(32, 159, 223), 2);
+    pen.setCosmetic(true);
+
+    setZValue(chart->zValue() + 1);
+
+    connect(chart, &QChart::plotAreaChanged, this, &ContourBatchItem::chartChanged);
+    connect(axis_x, &QValueAxis::rangeChanged, this, &ContourBatchItem::chartChanged);
+    connect(axis_y, &QValueAxis::rangeChanged, this, &ContourBatchItem::chartChanged);
+    connect(&path_watcher, &QFutureWatcher<QPainterPath>::finished, this, &ContourBatchItem::onPathBuilt);
+}
+
+ContourBatchItem::~ContourBatchItem() {
+    path_watcher.waitForFinished();
+}
+
+QPainterPath ContourBatchItem::buildPath(const ContourLod &lod, int level, const QRectF &view) {
+    QPainterPath path;
+    for (const QPolygonF &piece : lod.visible(level, view)) {
+        path.addPolygon(piece);
+    }
+    return path;
+}
+
+QTransform ContourBatchItem::graphToChart() const {
+    QRectF plot = chart->plotArea();
+    double scale_x = plot.width() / (axis_x->max() - axis_x->min());
+    double scale_y = plot.height() / (axis_y->max() - axis_y->min());
+    return QTransform(scale_x, 0, 0, -scale_y, plot.left() - axis_x->min() * scale_x, plot.bottom() + axis_y->min() * scale_y);
+}
+
+QRectF ContourBatchItem::boundingRect() const {
+    return chart->plotArea();
+}
+
+void ContourBatchItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    painter->setClipRect(chart->plotArea());
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+    painter->setTransform(graphToChart(), true);
+    painter->drawPath(path);
+
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+}
+
+void ContourBatchItem::chartChanged() {
+    // path is in graph coordinates, so old one is still drawn in right place
+    prepareGeometryChange();
+    update();
+
+    if (chart->plotArea().width() <= 0)
+        return;
+    if (path_watcher.isRunning()) {
+        path_outdated = true;
+        return;
+    }
+
+    path_outdated = false;
+    QRectF view(QPointF(axis_x->min(), axis_y->min()), QPointF(axis_x->max(), axis_y->max()));
+    int level = lod.levelFor(GraphChart::graphPerPixel(chart, axis_x));
+    path_watcher.setFuture(QtConcurrent::run(ContourBatchItem::buildPath, lod, level, view));
+}
+
+void ContourBatchItem::onPathBuilt() {
+    path = path_watcher.result();
+    update();
+    if (path_outdated)
+        chartChanged();
+}
@@ -0,0 +1,105 @@
+#ifndef GRAPHCHART_H
+#define GRAPHCHART_H
+
+#include <QtCharts>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QGraphicsObject>
+#include <QPainter>
+#include <QPainterPath>
+#include <QPolygonF>
+#include <QVector>
+
+#include "graphpreprocess.h"
+
+// decimation levels of contours for zoom dependent drawing
+// level l splits x axis into buckets of base_step * 2^l and keeps first, lowest, highest and last
+// point of every run of consecutive contour points inside one bucket, level 0 holds all points
+class ContourLod {
+private:
+    QVector<QVector<QPolygonF>> levels;
+    QVector<QRectF> bounds;
+    double x_origin, base_step;
+
+    static QPolygonF decimate(const QPolygonF &contour, double x_origin, double bucket);
+
+public:
+    ContourLod() : x_origin(0), base_step(1) {}
+
+    void build(const QVector<QPolygonF> &contours, double x_origin, double base_step);
+    int levelCount() const { return levels.count(); }
+    // coarsest level which bucket is not wider than one screen pixel
+    int levelFor(double graph_per_pixel) const;
+    const QVector<QPolygonF>& level(int l) const { return levels[l]; }
+    // pieces of level contours inside x range of view
+    QVector<QPolygonF> visible(int l, const QRectF &view) const;
+    // pieces of contour c only
+    QVector<QPolygonF> visible(int l, const QRectF &view, int c) const;
+};
+
+// contours converted to graph coordinates, prepared out of GUI thread
+struct ChartContours {
+    ContourLod lod;
+    QRectF range; // axes range covering the whole image
+};
+
+namespace GraphChart {
+    ChartContours prepareContours(const VectorizationProduct &result, const GraphTransform &graph_transform, const QSize &image_size);
+    QChart* createChart(const ChartContours &chart_contours, bool batched);
+    double graphPerPixel(QChart *chart, QValueAxis *axis_x);
+}
+
+// fills series with visible pieces of decimation level matching current zoom
+// contour split by view border gets extra series of the same color, unused ones are removed
+class SeriesLodController : public QObject {
+    Q_OBJECT;
+
+public:
+    explicit SeriesLodController(QChart *chart, QValueAxis *axis_x, QValueAxis *axis_y, const QList<QLineSeries*> &series, const ContourLod &lod);
+    ~SeriesLodController();
+
+private:
+    QChart *chart;
+    QValueAxis *axis_x, *axis_y;
+    QList<QList<QLineSeries*>> series; // pieces of every contour, first one is created with chart
+    ContourLod lod;
+    QTimer update_timer; // plot area and both ranges change together on zoom, series are filled once after them
+
+    QLineSeries* pieceSeries(int c, int k);
+
+public slots:
+    void chartChanged();
+    void updateSeries();
+};
+
+// draws visible contours as a single path inside chart plot area
+// path is built on worker after view changes, previous one is drawn until it is ready
+class ContourBatchItem : public QGraphicsObject {
+    Q_OBJECT;
+
+public:
+    explicit ContourBatchItem(QChart *chart, QValueAxis *axis_x, QValueAxis *axis_y, const ContourLod &lod);
+    ~ContourBatchItem();
+
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+    QChart *chart;
+    QValueAxis *axis_x, *axis_y;
+    ContourLod lod;
+    QPainterPath path; // visible contours in graph coordinates
+    bool path_outdated; // view changed while path was built
+    QFutureWatcher<QPainterPath> path_watcher;
+    QPen pen;
+
+    QTransform graphToChart() const;
+    static QPainterPath buildPath(const ContourLod &lod, int level, const QRectF &view);
+
+public slots:
+    void chartChanged();
+    void onPathBuilt();
+};
+
+#endif // GRAPHCHART_H
@@ -1,4 +1,5 @@
 #include "graphpreprocess.h"
+#include "resultcache.h"
 
 void GraphPreprocess::generateWidget(const QList<QMap<QString, QVariant>> &widget_properties) {
     interface_widget = new QGroupBox(group_name);
@@ -33,7 +34,7 @@ void VectorTransforms::generateWidget(const QList<QMap<QString, QVariant>> &widg
     widget_layout->addWidget(body_frame);
 
     QCheckBox *use_checkbox = new QCheckBox("use");
-    use_checkbox->setChecked(true);
+    use_checkbox->setChecked(use);
     tools_layout->addWidget(use_checkbox);
     connect(use_checkbox, &QCheckBox::stateChanged, this, &VectorTransforms::useFilter);
 
@@ -48,6 +49,74 @@ void VectorTransforms::useFilter(bool use) {
     this->use = use;
 }
 
+QLinkedList<QPoint> FreemanChain::toPoints(int ratio) const {
+    QLinkedList<QPoint> result;
+    QPoint pos = start;
+    for (int i = 0; i <= codes.size(); i++) {
+        if (i == 0 || i == codes.size() || (i - anchor) % ratio == 0) {
+            result.append(pos);
+        }
+        if (i < codes.size()) {
+            pos += QPoint(ChainCode::dx[int(codes[i])], ChainCode::dy[int(codes[i])]);
+        }
+    }
+    return result;
+}
+
+int GraphStoreBuilder::addNode(const QPoint &point, int parent) {
+    node_points.append(point);
+    node_parents.append(parent);
+    if (parent < 0) root_count++;
+    return node_points.count() - 1;
+}
+
+void GraphStore::translate(const QPoint &offset) {
+    if (offset.isNull() || arena.isEmpty())
+        return;
+    QPoint *nodes = reinterpret_cast<QPoint*>(arena.data() + sizeof(int) * 3);
+    for (int i = 0; i < nodeCount(); i++) {
+        nodes[i] += offset;
+    }
+}
+
+GraphStore GraphStoreBuilder::build() const {
+    int node_count = node_points.count();
+    int edge_count = node_count - root_count;
+
+    GraphStore store;
+    store.arena.resize(sizeof(int) * 3 + sizeof(QPoint) * node_count + sizeof(int) * ((node_count + 1) + edge_count + root_count));
+
+    int *header = reinterpret_cast<int*>(store.arena.data());
+    header[0] = node_count;
+    header[1] = edge_count;
+    header[2] = root_count;
+
+    QPoint *points = reinterpret_cast<QPoint*>(header + 3);
+    int *offsets = reinterpret_cast<int*>(points + node_count);
+    int *edges = offsets + node_count + 1;
+    int *roots = edges + edge_count;
+
+    std::copy(node_points.begin(), node_points.end(), points);
+
+    // counting sort of nodes by parent keeps children in insertion order
+    std::fill(offsets, offsets + node_count + 1, 0);
+    for (int parent : node_parents) {
+        if (parent >= 0) offsets[parent + 1]++;
+    }
+    for (int i = 0; i < node_count; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    QVector<int> fill_pos(offsets, offsets + node_count);
+    int root_pos = 0;
+    for (int i = 0; i < node_count; i++) {
+        if (node_parents[i] >= 0) edges[fill_pos[node_parents[i]]++] = i;
+        else roots[root_pos++] = i;
+    }
+
+    return store;
+}
+
 // process implementations
 LinearVectorization::LinearVectorization(QObject *parent) : Vectorization(parent) {
     m_ratio = 3;
@@ -63,160 +132,98 @@ LinearVectorization::LinearVectorization(QObject *parent) : Vectorization(parent
     }));
 }
 
-QLinkedList<QPoint> LinearVectorization::vectorizeCurve(const QImage &image, bool **used_field, const QPoint &start) {
-    QLinkedList<QPoint> result;
+FreemanChain LinearVectorization::traceCurve(const uchar *neighbours, uchar *used_field, int width, int height, const QPoint &start) {
+    // orthogonal steps are probed first, then diagonal ones
+    static const int order[8] = {4, 6, 0, 2, 5, 7, 1, 3};
+    const int offsets[8] = {1, 1 - width, -width, -width - 1, -1, width - 1, width, width + 1};
 
     auto nextStep {
-        [&](int x, int y, QPoint &cur_pos) {
-            if (image.pixelColor(cur_pos.x() + x, cur_pos.y() + y).value() > 0 && ! used_field[cur_pos.y() + y][cur_pos.x() + x]) {
-                used_field[cur_pos.y()][cur_pos.x()] = true;
-                cur_pos.setX(cur_pos.x() + x);
-                cur_pos.setY(cur_pos.y() + y);
-                return true;
+        [&](int pos) {
+            uchar bits = neighbours[pos];
+            for (int i = 0; i < 8; i++) {
+                int code = order[i];
+                if ((bits & (1 << code)) && ! used_field[pos + offsets[code]])
+                    return code;
             }
-            return false;
+            return -1;
         }
     };
 
     auto useNearest {
-        [&](QPoint pos, int align) {
-            if (align == 0) { // vertical
-                if (pos.y() > 0) {
-                    used_field[pos.y() - 1][pos.x()] = true;
+        [&](int pos, int code) {
+            int x = pos % width, y = pos / width;
+            if (code == 0 || code == 4) { // vertical
+                if (y > 0) {
+                    used_field[pos - width] = true;
                 }
-                if (pos.y() < image.height() - 1) {
-                    used_field[pos.y() + 1][pos.x()] = true;
+                if (y < height - 1) {
+                    used_field[pos + width] = true;
                 }
             }
-            else if (align == 1) { // horizontal
-                if (pos.x() > 0) {
-                    used_field[pos.y()][pos.x() - 1] = true;
+            else if (code == 2 || code == 6) { // horizontal
+                if (x > 0) {
+                    used_field[pos - 1] = true;
                 }
-                if (pos.y() < image.width() - 1) {
-                    used_field[pos.y()][pos.x() + 1] = true;
+                if (x < width - 1) {
+                    used_field[pos + 1] = true;
                 }
             }
         }
     };
 
-    QPoint cur_pos = start;
-    QPoint prev_pos = cur_pos;
-    int cur_step = 0;
-    bool found = true, first = true;
-    while (found) {
-        if (cur_step % this->m_ratio == 0) {
-            result.append(cur_pos);
-        }
-
-        found = false;
-
-        if (nextStep(-1, 0, cur_pos)) {
-            if (!first) useNearest(prev_pos, 0);
-            found = true;
-        }
-        else if (nextStep(0, 1, cur_pos)) {
-            if (!first) useNearest(prev_pos, 1);
-            found = true;
-        }
-        else if (nextStep(1, 0, cur_pos)) {
-            if (!first) useNearest(prev_pos, 0);
-            found = true;
-        }
-        else if (nextStep(0, -1, cur_pos)) {
-            if (!first) useNearest(prev_pos, 1);
-            found = true;
-        }
-        else if (nextStep(-1, 1, cur_pos)) found = true;
-        else if (nextStep(1, 1, cur_pos)) found = true;
-        else if (nextStep(1, -1, cur_pos)) found = true;
-        else if (nextStep(-1, -1, cur_pos)) found = true;
-
-        if (! found) {
-            if (cur_step % this->m_ratio != 0) {
-                result.append(cur_pos);
+    auto trace {
+        [&](QByteArray &codes, bool use_first) {
+            int pos = start.y() * width + start.x();
+            int code;
+            while ((code = nextStep(pos)) >= 0) {
+                used_field[pos] = true;
+                if (use_first || ! codes.isEmpty()) useNearest(pos, code);
+                codes.append(char(code));
+                pos += offsets[code];
             }
-            break;
-        }
-
-        cur_step++;
-        prev_pos = cur_pos;
-        first = false;
-    }
-
-
-    prev_pos = cur_pos = start;
-    cur_step = 0;
-    found = true;
-    while (found) {
-        found = false;
-
-        if (nextStep(-1, 0, cur_pos)) {
-            useNearest(prev_pos, 0);
-            found = true;
-        }
-        else if (nextStep(0, 1, cur_pos)) {
-            useNearest(prev_pos, 1);
-            found = true;
-        }
-        else if (nextStep(1, 0, cur_pos)) {
-            useNearest(prev_pos, 0);
-            found = true;
-        }
-        else if (nextStep(0, -1, cur_pos)) {
-            useNearest(prev_pos, 1);
-            found = true;
-        }
-        else if (nextStep(-1, 1, cur_pos)) found = true;
-        else if (nextStep(1, 1, cur_pos)) found = true;
-        else if (nextStep(1, -1, cur_pos)) found = true;
-        else if (nextStep(-1, -1, cur_pos)) found = true;
-
-        if (! found) {
-            if (cur_step % this->m_ratio != 0) {
-                result.prepend(cur_pos);
-            }
-            break;
         }
+    };
 
-        cur_step++;
+    QByteArray forward, backward;
+    trace(forward, false);
+    trace(backward, true);
 
-        if (cur_step % this->m_ratio == 0) {
-            result.prepend(cur_pos);
-        }
-
-        prev_pos = cur_pos;
+    // backward part is reversed so the chain runs from its far end through start
+    FreemanChain chain;
+    chain.start = start;
+    for (char code : backward) {
+        chain.start += QPoint(ChainCode::dx[int(code)], ChainCode::dy[int(code)]);
+    }
+    chain.codes.reserve(backward.size() + forward.size());
+    for (int i = backward.size() - 1; i >= 0; i--) {
+        chain.codes.append(char((backward[i] + 4) % 8));
     }
+    chain.codes.append(forward);
+    chain.anchor = backward.size();
 
-    return result;
+    return chain;
 }
 
 VectorizationProduct LinearVectorization::processData(const QImage &image) {
-    bool **used_field = new bool*[image.height()];
-    for (int i = 0; i < image.height(); i++) {
-        used_field[i] = new bool[image.width()];
-        for (int j = 0; j < image.width(); j++) {
-            used_field[i][j] = false;
-        }
-    }
+    int width = image.width(), height = image.height();
+    QVector<uchar> foreground = ImageAlgorithms::foregroundPlane(image);
+    QVector<uchar> neighbours = ImageAlgorithms::neighbourMask(foreground, width, height);
+    QVector<uchar> used_field(width * height, false);
 
     VectorizationProduct vp;
 
-    for (int y = 0; y < image.height(); y++) {
-        for (int x = 0; x < image.width(); x++) {
-            if (! used_field[y][x]) {
-                if (image.pixelColor(x, y).value() > 0) {
-                    vp.append(this->vectorizeCurve(image, used_field, QPoint(x, y)));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int pos = y * width + x;
+            if (! used_field[pos]) {
+                if (foreground[pos]) {
+                    vp.append(this->traceCurve(neighbours.constData(), used_field.data(), width, height, QPoint(x, y)).toPoints(m_ratio));
                 }
             }
-            used_field[y][x] = true;
+            used_field[pos] = true;
         }
     }
 
-    for (int i = 0; i < image.height(); i++) {
-        delete [] used_field[i];
-    }
-    delete [] used_field;
-
     return vp;
 }
 
@@ -378,6 +385,387 @@ VectorizationProduct VectorMerge::processData(const VectorizationProduct &vp) {
 
 VectorMerge::~VectorMerge() {}
 
+
+
+VectorSimplification::VectorSimplification(double tolerance, QObject *parent) : VectorTransforms(parent) {
+    m_method = "douglas_peucker";
+    m_tolerance = tolerance;
+    m_graph_units = false;
+    // drops traced points, so default vectorization output stays as it was until user switches it on
+    use = false;
+
+    group_name = "Simplification";
+    generateWidget(QList<QMap<QString, QVariant>>(
+    {
+        {
+            std::pair<QString, QVariant>("name", "method"),
+            std::pair<QString, QVariant>("field_type", "list"),
+            std::pair<QString, QVariant>("variants", QStringList({"douglas_peucker", "visvalingam"}))
+        },
+        {
+            std::pair<QString, QVariant>("name", "tolerance"),
+            std::pair<QString, QVariant>("min", 0),
+            std::pair<QString, QVariant>("max", 1000000)
+        },
+        {
+            std::pair<QString, QVariant>("name", "graph_units")
+        }
+    }));
+}
+
+QVector<int> VectorSimplification::douglasPeucker(const QVector<QPointF> &points, double tolerance) {
+    int count = points.count();
+    QVector<bool> keep(count, false);
+    keep[0] = keep[count - 1] = true;
+
+    double tolerance_sq = tolerance * tolerance;
+
+    // iterative to not overflow the stack on long curves
+    QStack<QPair<int, int>> ranges;
+    ranges.push(qMakePair(0, count - 1));
+    while (! ranges.isEmpty()) {
+        QPair<int, int> range = ranges.pop();
+        QPointF a = points[range.first], b = points[range.second];
+        QPointF ab = b - a;
+        double ab_len_sq = QPointF::dotProduct(ab, ab);
+
+        int max_ind = -1;
+        double max_dist_sq = tolerance_sq;
+        for (int i = range.first + 1; i < range.second; i++) {
+            QPointF ap = points[i] - a;
+            double dist_sq;
+            if (ab_len_sq > 0) {
+                double cross = ab.x() * ap.y() - ab.y() * ap.x();
+                dist_sq = cross * cross / ab_len_sq;
+            }
+            else {
+                dist_sq = QPointF::dotProduct(ap, ap); // closed contour
+            }
+            if (dist_sq > max_dist_sq) {
+                max_dist_sq = dist_sq;
+                max_ind = i;
+            }
+        }
+
+        if (max_ind >= 0) {
+            keep[max_ind] = true;
+            if (max_ind - range.first > 1) ranges.push(qMakePair(range.first, max_ind));
+            if (range.second - max_ind > 1) ranges.push(qMakePair(max_ind, range.second));
+        }
+    }
+
+    QVector<int> result;
+    for (int i = 0; i < count; i++) {
+        if (keep[i]) result.append(i);
+    }
+    return result;
+}
+
+QVector<int> VectorSimplification::visvalingam(const QVector<QPointF> &points, double tolerance) {
+    int count = points.count();
+    QVector<int> prev(count), next(count);
+    QVector<double> area(count, std::numeric_limits<double>::max());
+    for (int i = 0; i < count; i++) {
+        prev[i] = i - 1;
+        next[i] = i + 1;
+    }
+
+    auto triangleArea {
+        [&](int i) {
+            QPointF a = points[prev[i]], b = points[i], c = points[next[i]];
+            return fabs((b.x() - a.x()) * (c.y() - a.y()) - (c.x() - a.x()) * (b.y() - a.y())) * 0.5;
+        }
+    };
+
+    // min-heap of (effective area, index), outdated entries are skipped on pop
+    typedef std::pair<double, int> HeapItem;
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap;
+    for (int i = 1; i < count - 1; i++) {
+        area[i] = triangleArea(i);
+        heap.push(HeapItem(area[i], i));
+    }
+
+    // tolerance is a length, compare with area of triangle with such base and height
+    double threshold = tolerance * tolerance * 0.5;
+    QVector<bool> removed(count, false);
+    double last_area = 0;
+    while (! heap.empty()) {
+        HeapItem item = heap.top();
+        heap.pop();
+        int i = item.second;
+        if (removed[i] || item.first != area[i])
+            continue;
+
+        // effective area never decreases, so removed neighbours do not come back
+        last_area = std::max(last_area, item.first);
+        if (last_area >= threshold)
+            break;
+
+        removed[i] = true;
+        next[prev[i]] = next[i];
+        prev[next[i]] = prev[i];
+        for (int n : {prev[i], next[i]}) {
+            if (n > 0 && n < count - 1) {
+                area[n] = triangleArea(n);
+                heap.push(HeapItem(area[n], n));
+            }
+        }
+    }
+
+    QVector<int> result;
+    for (int i = 0; i < count; i++) {
+        if (! removed[i]) result.append(i);
+    }
+    return result;
+}
+
+QLinkedList<QPoint> VectorSimplification::simplifyCurve(const QLinkedList<QPoint> &curve) {
+    if (curve.count() < 3)
+        return curve;
+
+    // tolerance is measured in graph units when scale differs by axes
+    double scale_x = m_graph_units ? graph_transform.scaleX() : 1;
+    double scale_y = m_graph_units ? graph_transform.scaleY() : 1;
+
+    QVector<QPoint> pixels;
+    QVector<QPointF> points;
+    pixels.reserve(curve.count());
+    points.reserve(curve.count());
+    for (auto it = curve.begin(); it != curve.end(); it++) {
+        pixels.append(*it);
+        points.append(QPointF(it->x() * scale_x, it->y() * scale_y));
+    }
+
+    QVector<int> kept = m_method == "visvalingam" ? visvalingam(points, m_tolerance) : douglasPeucker(points, m_tolerance);
+
+    QLinkedList<QPoint> result;
+    for (int i : kept) {
+        result.append(pixels[i]);
+    }
+    return result;
+}
+
+VectorizationProduct VectorSimplification::processData(const VectorizationProduct &vp) {
+    QVector<QLinkedList<QPoint>> curves;
+    curves.reserve(vp.count());
+    for (auto it = vp.begin(); it != vp.end(); it++) {
+        curves.append(*it);
+    }
+
+    // contours are independent, simplify them in parallel
+    QtConcurrent::blockingMap(curves, [this](QLinkedList<QPoint> &curve) {
+        curve = simplifyCurve(curve);
+    });
+
+    VectorizationProduct result;
+    for (int i = 0; i < curves.count(); i++) {
+        result.append(curves[i]);
+    }
+    return result;
+}
+
+VectorSimplification::~VectorSimplification() {}
+
+
+
+VectorResampling::VectorResampling(double step, QObject *parent) : VectorTransforms(parent) {
+    m_step = step;
+    m_method = "linear";
+    // replaces traced points by samples, so it is switched on by user
+    use = false;
+
+    group_name = "Resampling";
+    generateWidget(QList<QMap<QString, QVariant>>(
+    {
+        {
+            std::pair<QString, QVariant>("name", "step"),
+            std::pair<QString, QVariant>("min", 0),
+            std::pair<QString, QVariant>("max", 1000000)
+        },
+        {
+            std::pair<QString, QVariant>("name", "method"),
+            std::pair<QString, QVariant>("field_type", "list"),
+            std::pair<QString, QVariant>("variants", QStringList({"linear", "spline"}))
+        }
+    }));
+}
+
+QVector<QVector<QPointF>> VectorResampling::monotonePieces(const QLinkedList<QPoint> &curve) {
+    // vertical runs of traced pixels give one point with mean y
+    QVector<QPointF> points;
+    int run = 0;
+    for (const QPoint &pixel : curve) {
+        QPointF point = graph_transform.toGraph(pixel);
+        if (run > 0 && point.x() == points.last().x()) {
+            points.last().setY((points.last().y() * run + point.y()) / (run + 1));
+            run++;
+        }
+        else {
+            points.append(point);
+            run = 1;
+        }
+    }
+
+    // piece ends where x turns back, turning point starts next piece
+    QVector<QVector<QPointF>> pieces;
+    QVector<QPointF> piece;
+    int dir = 0;
+    for (int i = 0; i < points.count(); i++) {
+        if (i > 0) {
+            int d = points[i].x() > points[i - 1].x() ? 1 : -1;
+            if (dir != 0 && d != dir) {
+                if (dir < 0)
+                    std::reverse(piece.begin(), piece.end());
+                pieces.append(piece);
+                piece = QVector<QPointF>({points[i - 1]});
+            }
+            dir = d;
+        }
+        piece.append(points[i]);
+    }
+    if (piece.count() > 1) {
+        if (dir < 0)
+            std::reverse(piece.begin(), piece.end());
+        pieces.append(piece);
+    }
+    return pieces;
+}
+
+void VectorResampling::sampleLinear(const QVector<QPointF> &piece, double x0, double step, int count, double *x, double *y) {
+    int j = 0;
+    for (int k = 0; k < count; k++) {
+        double xs = x0 + k * step;
+        while (j + 2 < piece.count() && piece[j + 1].x() < xs)
+            j++;
+        double t = qBound(0.0, (xs - piece[j].x()) / (piece[j + 1].x() - piece[j].x()), 1.0);
+        x[k] = xs;
+        y[k] = piece[j].y() + (piece[j + 1].y() - piece[j].y()) * t;
+    }
+}
+
+void VectorResampling::sampleSpline(const QVector<QPointF> &piece, double x0, double step, int count, double *x, double *y) {
+    int n = piece.count();
+    if (n < 3) {
+        sampleLinear(piece, x0, step, count, x, y);
+        return;
+    }
+
+    // second derivatives of natural cubic spline, tridiagonal system solved by forward sweep
+    QVector<double> m(n, 0), c(n, 0), d(n, 0);
+    for (int i = 1; i < n - 1; i++) {
+        double h0 = piece[i].x() - piece[i - 1].x(), h1 = piece[i + 1].x() - piece[i].x();
+        double rhs = 6 * ((piece[i + 1].y() - piece[i].y()) / h1 - (piece[i].y() - piece[i - 1].y()) / h0);
+        double denom = 2 * (h0 + h1) - h0 * c[i - 1];
+        c[i] = h1 / denom;
+        d[i] = (rhs - h0 * d[i - 1]) / denom;
+    }
+    for (int i = n - 2; i > 0; i--) {
+        m[i] = d[i] - c[i] * m[i + 1];
+    }
+
+    int j = 0;
+    for (int k = 0; k < count; k++) {
+        double xs = x0 + k * step;
+        while (j + 2 < n && piece[j + 1].x() < xs)
+            j++;
+        double h = piece[j + 1].x() - piece[j].x();
+        double b = qBound(0.0, (xs - piece[j].x()) / h, 1.0), a = 1 - b;
+        x[k] = xs;
+        y[k] = a * piece[j].y() + b * piece[j + 1].y() + ((a * a * a - a) * m[j] + (b * b * b - b) * m[j + 1]) * h * h / 6;
+    }
+}
+
+VectorizationProduct VectorResampling::processData(const VectorizationProduct &vp) {
+    if (m_step <= 0)
+        return vp;
+
+    QVector<QLinkedList<QPoint>> curves;
+    curves.reserve(vp.count());
+    for (auto it = vp.begin(); it != vp.end(); it++) {
+        curves.append(*it);
+    }
+
+    // pieces of contours are found in parallel
+    QVector<QVector<QVector<QPointF>>> contour_pieces(curves.count());
+    QVector<int> contour_ids(curves.count());
+    std::iota(contour_ids.begin(), contour_ids.end(), 0);
+    QtConcurrent::blockingMap(contour_ids, [&](int c) {
+        contour_pieces[c] = monotonePieces(curves[c]);
+    });
+
+    // doubled step keeps samples on the requested grid, so it is enlarged until count fits int offsets
+    double step = m_step;
+    auto sampleCount {
+        [&](double grid_step) {
+            double count = 0;
+            for (const QVector<QVector<QPointF>> &piece_list : contour_pieces) {
+                for (const QVector<QPointF> &piece : piece_list) {
+                    count += std::max(0.0, floor(piece.last().x() / grid_step) - ceil(piece.first().x() / grid_step) + 1);
+                }
+            }
+            return count;
+        }
+    };
+    while (sampleCount(step) > std::numeric_limits<int>::max()) {
+        step *= 2;
+    }
+    if (step != m_step)
+        emit stepEnlarged(step);
+
+    // grid samples of every piece get their place in output arrays
+    QSharedPointer<ResampledCurves> result = QSharedPointer<ResampledCurves>::create();
+    result->step = step;
+    result->offsets.append(0);
+    QVector<const QVector<QPointF>*> pieces;
+    QVector<double> grid_starts;
+    qint64 total = 0;
+    for (int c = 0; c < contour_pieces.count(); c++) {
+        for (const QVector<QPointF> &piece : contour_pieces[c]) {
+            qint64 k0 = ceil(piece.first().x() / step), k1 = floor(piece.last().x() / step);
+            if (k1 < k0)
+                continue;
+            total += k1 - k0 + 1;
+            pieces.append(&piece);
+            grid_starts.append(k0 * step);
+            result->offsets.append(total);
+            result->contours.append(c);
+        }
+    }
+    result->x.resize(total);
+    result->y.resize(total);
+
+    // pieces are sampled in parallel straight into contiguous arrays
+    double *xs = result->x.data(), *ys = result->y.data();
+    bool spline = m_method == "spline";
+    QVector<QLinkedList<QPoint>> sampled_curves(pieces.count());
+    QVector<int> piece_ids(pieces.count());
+    std::iota(piece_ids.begin(), piece_ids.end(), 0);
+    QtConcurrent::blockingMap(piece_ids, [&](int p) {
+        int offset = result->offsets[p], count = result->offsets[p + 1] - offset;
+        if (spline)
+            sampleSpline(*pieces[p], grid_starts[p], step, count, xs + offset, ys + offset);
+        else
+            sampleLinear(*pieces[p], grid_starts[p], step, count, xs + offset, ys + offset);
+
+        QLinkedList<QPoint> &curve = sampled_curves[p];
+        for (int i = offset; i < offset + count; i++) {
+            QPoint pixel(lround(graph_transform.start_pixel_x + xs[i] / graph_transform.scaleX()), lround(graph_transform.start_pixel_y - ys[i] / graph_transform.scaleY()));
+            if (curve.isEmpty() || curve.last() != pixel)
+                curve.append(pixel);
+        }
+    });
+
+    emit samplesReady(result);
+
+    VectorizationProduct product;
+    for (int p = 0; p < sampled_curves.count(); p++) {
+        product.append(sampled_curves[p]);
+    }
+    return product;
+}
+
+VectorResampling::~VectorResampling() {}
+
 // GraphProcessor
 
 GraphProcessor::GraphProcessor(QWidget *prop_group_widget, QObject *parent) : QObject(parent) {
@@ -404,10 +792,34 @@ void GraphProcessor::setMiddleware(Vectorization *vectorization_filter, const QL
     }
 }
 
-void GraphProcessor::processGraph(const QImage &image) {
+QByteArray GraphProcessor::chainSignature() {
+    QByteArray signature = ResultCache::stageSignature(vectorization_filter, true);
+    for (int i = 0; i < vector_trans_filters.count(); i++) {
+        signature += ResultCache::stageSignature(vector_trans_filters[i], vector_trans_filters[i]->isUse());
+    }
+    return signature;
+}
+
+bool GraphProcessor::isCacheable() {
+    for (int i = 0; i < vector_trans_filters.count(); i++) {
+        if (vector_trans_filters[i]->isUse() && qobject_cast<VectorResampling*>(vector_trans_filters[i]) != nullptr)
+            return false;
+    }
+    return true;
+}
+
+void GraphProcessor::processGraph(const QImage &image, const QPoint &offset) {
     emit startCalculating(1 + vector_trans_filters.count(), "Processing graph...");
     VectorizationProduct vectorization_result;
 
+    // stages work in processed region pixels, so axes origin moves with region
+    GraphTransform region_transform = graph_transform;
+    region_transform.start_pixel_x -= offset.x();
+    region_transform.start_pixel_y -= offset.y();
+    for (auto it = vector_trans_filters.begin(); it != vector_trans_filters.end(); it++) {
+        (*it)->setGraphTransform(region_transform);
+    }
+
 
     int f_ind = 0;
     emit currentFilter(f_ind, vectorization_filter->getGroupName());
@@ -422,8 +834,20 @@ void GraphProcessor::processGraph(const QImage &image) {
         vectorization_result = vector_trans_filters[i]->processData(vectorization_result);
     }
 
+    if (! offset.isNull()) {
+        for (auto it = vectorization_result.begin(); it != vectorization_result.end(); it++) {
+            for (auto it_2 = it->begin(); it_2 != it->end(); it_2++) {
+                *it_2 += offset;
+            }
+        }
+    }
+
     emit finishCalculating();
-    emit resultReady(vectorization_result);
+    emit resultReady(VectorizationResult::create(std::move(vectorization_result)));
+}
+
+void GraphProcessor::setGraphTransform(const GraphTransform &graph_transform) {
+    this->graph_transform = graph_transform;
 }
 
 
@@ -432,6 +856,7 @@ void GraphProcessor::processGraph(const QImage &image) {
 
 LinearVectorizationGraph::LinearVectorizationGraph(QObject *parent) : VectorizationGraph(parent) {
     m_square_size = 5;
+    perimeter_square_size = perimeter_width = -1;
 
     group_name = "Graph vectorization";
     generateWidget(QList<QMap<QString, QVariant>>(
@@ -444,39 +869,53 @@ LinearVectorizationGraph::LinearVectorizationGraph(QObject *parent) : Vectorizat
     }));
 }
 
-GraphPoint* LinearVectorizationGraph::vectorizeCurve(const QImage &image, bool **used_field, const QPoint &start) {
+void LinearVectorizationGraph::buildPerimeter(int width) {
+    if (perimeter_square_size == m_square_size && perimeter_width == width)
+        return;
+
+    int half = m_square_size / 2;
+    perimeter_shifts.clear();
+    for (int i = -half; i < half; i++) {
+        perimeter_shifts.append(QPoint(i, -half)); // top row, left to right
+    }
+    for (int i = -half; i < half; i++) {
+        perimeter_shifts.append(QPoint(half, i)); // right column, top to bottom
+    }
+    for (int i = half; i > -half; i--) {
+        perimeter_shifts.append(QPoint(i, half)); // bottom row, right to left
+    }
+    for (int i = half; i >= -half; i--) {
+        perimeter_shifts.append(QPoint(-half, i)); // left column, bottom to top
+    }
+
+    perimeter_offsets.resize(perimeter_shifts.count());
+    for (int i = 0; i < perimeter_shifts.count(); i++) {
+        perimeter_offsets[i] = perimeter_shifts[i].y() * width + perimeter_shifts[i].x();
+    }
+
+    perimeter_square_size = m_square_size;
+    perimeter_width = width;
+}
+
+void LinearVectorizationGraph::vectorizeCurve(const uchar *foreground, uchar *used_field, int width, int height, const QPoint &start, GraphStoreBuilder &graph) {
     int sq_s = m_square_size; // square size
+    const int *offsets = perimeter_offsets.constData();
+    int perimeter_size = perimeter_offsets.count();
 
-    GraphPoint *result = new GraphPoint(start);
-    GraphPoint *cur_graph = result;
-    GraphPoint *new_graph;
-    QStack<GraphPoint*> branches;
+    int cur_graph = graph.addNode(start);
+    QStack<int> branches;
 
     auto checkBorders {
-        [&](GraphPoint* cur_graph) {
-            QPoint pos = cur_graph->point();
-            QList<QPoint> points;
-            for (int i = -(sq_s / 2); i < sq_s / 2; i++) {
-                points.push_back(QPoint(pos.x() + i, pos.y() - sq_s / 2));
-            }
-            for (int i = -(sq_s / 2); i < sq_s / 2; i++) {
-                points.push_back(QPoint(pos.x() + sq_s / 2, pos.y() + i));
-            }
-            for (int i = sq_s / 2; i > -(sq_s / 2); i--) {
-                points.push_back(QPoint(pos.x() + i, pos.y() + sq_s / 2));
-            }
-            for (int i = sq_s / 2; i >= -(sq_s / 2); i--) {
-                points.push_back(QPoint(pos.x() - sq_s / 2, pos.y() + i));
-            }
-
-            bool first = ! used_field[points[0].y()][points[0].x()] && image.pixelColor(points[0].x(), points[0].y()).value() > 0;
-            bool cur = first;
-            for (int i = 1; i < points.length(); i++) {
-                bool next = ! used_field[points[i].y()][points[i].x()] && image.pixelColor(points[i].x(), points[i].y()).value() > 0;
+        [&](int cur_graph) {
+            QPoint pos = graph.point(cur_graph);
+            int center = pos.y() * width + pos.x();
+
+            bool cur = ! used_field[center + offsets[0]] && foreground[center + offsets[0]];
+            for (int i = 1; i < perimeter_size; i++) {
+                int p = center + offsets[i];
+                bool next = ! used_field[p] && foreground[p];
                 if (!cur && next) {
-                    new_graph = new GraphPoint(points[i]);
-                    cur_graph->addNext(new_graph);
-                    branches.push(new_graph);
+                    branches.push(graph.addNode(pos + perimeter_shifts[i], cur_graph));
                 }
                 cur = next;
             }
@@ -485,10 +924,9 @@ GraphPoint* LinearVectorizationGraph::vectorizeCurve(const QImage &image, bool *
 
     auto useSquare {
         [&](const QPoint &pos) {
-            for (int i = -(sq_s / 2); i <= sq_s / 2; i++) {
-                for (int j = -(sq_s / 2); j <= sq_s / 2; j++) {
-                    used_field[pos.y() + j][pos.x() + i] = true;
-                }
+            for (int j = -(sq_s / 2); j <= sq_s / 2; j++) {
+                uchar *line = used_field + (pos.y() + j) * width + pos.x();
+                std::fill(line - sq_s / 2, line + sq_s / 2 + 1, true);
             }
         }
     };
@@ -496,43 +934,36 @@ GraphPoint* LinearVectorizationGraph::vectorizeCurve(const QImage &image, bool *
     branches.push(cur_graph);
     while (branches.length() > 0) {
         cur_graph = branches.pop();
-        if (cur_graph->point().x() > sq_s/2 && cur_graph->point().y() > sq_s/2 && cur_graph->point().x() < image.width() - sq_s/2 && cur_graph->point().y() < image.height() - sq_s/2 ) {
+        QPoint cur_point = graph.point(cur_graph);
+        if (cur_point.x() > sq_s/2 && cur_point.y() > sq_s/2 && cur_point.x() < width - sq_s/2 && cur_point.y() < height - sq_s/2 ) {
             checkBorders(cur_graph);
-            useSquare(cur_graph->point());
+            useSquare(cur_point);
         }
     }
-
-    return result;
 }
 
 VectorizationProductGraph LinearVectorizationGraph::processData(const QImage &image) {
-    bool **used_field = new bool*[image.height()];
-    for (int i = 0; i < image.height(); i++) {
-        used_field[i] = new bool[image.width()];
-        for (int j = 0; j < image.width(); j++) {
-            used_field[i][j] = false;
-        }
-    }
+    int width = image.width(), height = image.height();
+    QVector<uchar> foreground = ImageAlgorithms::foregroundPlane(image);
+    QVector<uchar> used_field(width * height, false);
+
+    buildPerimeter(width);
 
-    VectorizationProductGraph vp;
+    GraphStoreBuilder graph;
 
-    for (int y = 0; y < image.height(); y++) {
-        for (int x = 0; x < image.width(); x++) {
-            if (! used_field[y][x]) {
-                if (image.pixelColor(x, y).value() > 0) {
-                    vp.append(this->vectorizeCurve(image, used_field, QPoint(x, y)));
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int pos = y * width + x;
+            if (! used_field[pos]) {
+                if (foreground[pos]) {
+                    this->vectorizeCurve(foreground.constData(), used_field.data(), width, height, QPoint(x, y), graph);
                 }
             }
-            used_field[y][x] = true;
+            used_field[pos] = true;
         }
     }
 
-    for (int i = 0; i < image.height(); i++) {
-        delete [] used_field[i];
-    }
-    delete [] used_field;
-
-    return vp;
+    return graph.build();
 }
 
 LinearVectorizationGraph::~LinearVectorizationGraph() {}
@@ -556,7 +987,7 @@ void GraphProcessorGraph::setMiddleware(VectorizationGraph *vectorization_filter
     }
 }
 
-void GraphProcessorGraph::processGraph(const QImage &image) {
+void GraphProcessorGraph::processGraph(const QImage &image, const QPoint &offset) {
     emit startCalculating(1, "Processing graph...");
     VectorizationProductGraph vectorization_result;
 
@@ -565,7 +996,8 @@ void GraphProcessorGraph::processGraph(const QImage &image) {
     emit currentFilter(f_ind, vectorization_filter->getGroupName());
     f_ind++;
     vectorization_result = vectorization_filter->processData(image);
+    vectorization_result.translate(offset);
 
     emit finishCalculating();
-    emit resultReady(vectorization_result);
+    emit resultReady(VectorizationResultGraph::create(std::move(vectorization_result)));
 }
@@ -27,36 +27,131 @@
 #include <QMap>
 #include <QVariant>
 #include <QImage>
+#include <QVector>
+#include <QByteArray>
+#include <QPointF>
+#include <QSharedPointer>
+
+#include <QtConcurrent>
 
 #include <QDebug>
 
 #include <limits>
+#include <queue>
+#include <numeric>
+#include <algorithm>
 
 #include "formgenerator.h"
+#include "algorithms.h"
 
-class GraphPoint {
+// forest of vectorization graphs stored in one arena buffer
+// layout: counts, node points, CSR child offsets (nodes + 1), child indexes, root indexes
+class GraphStore {
 private:
-    QPoint m_point;
-    QList<GraphPoint*> next_points;
+    QByteArray arena;
+
+    const int* header() const { return reinterpret_cast<const int*>(arena.constData()); }
+    const QPoint* points() const { return reinterpret_cast<const QPoint*>(header() + 3); }
+    const int* offsets() const { return reinterpret_cast<const int*>(points() + nodeCount()); }
+    const int* edges() const { return offsets() + nodeCount() + 1; }
+    const int* roots() const { return edges() + edgeCount(); }
+
+    friend class GraphStoreBuilder;
 
 public:
-    GraphPoint() : m_point(0, 0) {}
-    GraphPoint(const QPoint &point) : m_point(point) {}
+    int nodeCount() const { return arena.isEmpty() ? 0 : header()[0]; }
+    int edgeCount() const { return arena.isEmpty() ? 0 : header()[1]; }
+    int rootCount() const { return arena.isEmpty() ? 0 : header()[2]; }
+    void translate(const QPoint &offset);
+
+    int root(int i) const { return roots()[i]; }
+    QPoint point(int node) const { return points()[node]; }
+    int childCount(int node) const { return offsets()[node + 1] - offsets()[node]; }
+    const int* childrenBegin(int node) const { return edges() + offsets()[node]; }
+    const int* childrenEnd(int node) const { return edges() + offsets()[node + 1]; }
+
+    // calls f with points of every branch between root, fork and leaf nodes
+    template<typename F> void forEachBranch(F f) const;
+};
 
-    QPoint point() { return m_point; }
-    void setPoint(const QPoint &point) { m_point = point; }
-    void addNext(GraphPoint *next) { next_points.append(next); }
-    QList<GraphPoint*> getNext() { return next_points; }
+// collects nodes with their parents while a graph grows, then packs them into GraphStore
+class GraphStoreBuilder {
+private:
+    QVector<QPoint> node_points;
+    QVector<int> node_parents;
+    int root_count = 0;
 
-    ~GraphPoint() {
-        for (GraphPoint* gp : next_points) {
-            delete gp;
+public:
+    int addNode(const QPoint &point, int parent = -1);
+    QPoint point(int node) const { return node_points[node]; }
+    GraphStore build() const;
+};
+
+template<typename F> void GraphStore::forEachBranch(F f) const {
+    for (int r = 0; r < rootCount(); r++) {
+        QStack<int> forks;
+        forks.push(root(r));
+        while (! forks.isEmpty()) {
+            int node = forks.pop();
+            for (const int *next = childrenBegin(node); next != childrenEnd(node); next++) {
+                // single child chains are followed up to next fork or leaf
+                QLinkedList<QPoint> branch;
+                branch.append(point(node));
+                int cur = *next;
+                while (childCount(cur) == 1) {
+                    branch.append(point(cur));
+                    cur = *childrenBegin(cur);
+                }
+                branch.append(point(cur));
+                f(branch);
+                if (childCount(cur) > 1)
+                    forks.push(cur);
+            }
         }
     }
-};
+}
 
 typedef QLinkedList<QLinkedList<QPoint>> VectorizationProduct;
-typedef QList<GraphPoint*> VectorizationProductGraph;
+typedef GraphStore VectorizationProductGraph;
+
+// results cross threads as shared immutable objects, products are moved into them without copying
+typedef QSharedPointer<const VectorizationProduct> VectorizationResult;
+typedef QSharedPointer<const VectorizationProductGraph> VectorizationResultGraph;
+
+// y(x) samples of x-monotone contour pieces on a uniform grid, in graph units
+// samples of piece p are x[offsets[p]] .. x[offsets[p + 1] - 1], x grows inside piece
+struct ResampledCurves {
+    double step = 0;
+    QVector<double> x, y;
+    QVector<int> offsets; // pieces + 1
+    QVector<int> contours; // source contour of each piece
+
+    int pieceCount() const { return contours.count(); }
+};
+typedef QSharedPointer<const ResampledCurves> ResampledResult;
+
+// traced curve as its start point and chain code directions of each step
+// decimation keeps every ratio-th step counting from the anchor step
+struct FreemanChain {
+    QPoint start;
+    QByteArray codes;
+    int anchor = 0;
+
+    QLinkedList<QPoint> toPoints(int ratio) const;
+};
+
+// mapping from image pixels to graph units (axis origin, pixels per step, step size)
+struct GraphTransform {
+    int start_pixel_x = 0, start_pixel_y = 0;
+    int pps_x = 1, pps_y = 1;
+    double step_x = 1, step_y = 1;
+
+    double scaleX() const { return step_x / pps_x; }
+    double scaleY() const { return step_y / pps_y; }
+    QPointF toGraph(const QPointF &point) const {
+        return QPointF((point.x() - start_pixel_x) * scaleX(), (start_pixel_y - point.y()) * scaleY());
+    }
+};
 
 class GraphPreprocess : public FormGenerator {
     Q_OBJECT;
@@ -95,6 +190,7 @@ class VectorTransforms : public GraphPreprocess {
 
 protected:
     bool use;
+    GraphTransform graph_transform;
 
     // use generateWidget in constructor of extended class
     // it may generate interface widget for this image processor using its meta properties
@@ -103,6 +199,7 @@ protected:
 public:
     explicit VectorTransforms(QObject *parent = nullptr);
     bool isUse() { return use; }
+    void setGraphTransform(const GraphTransform &graph_transform) { this->graph_transform = graph_transform; }
     virtual VectorizationProduct processData(const VectorizationProduct &vp) = 0;
     virtual ~VectorTransforms();
 
@@ -120,7 +217,7 @@ class LinearVectorization : public Vectorization {
 private:
     int m_ratio;
 
-    QLinkedList<QPoint> vectorizeCurve(const QImage &image, bool **used_field, const QPoint &start);
+    FreemanChain traceCurve(const uchar *neighbours, uchar *used_field, int width, int height, const QPoint &start);
 
 public:
     explicit LinearVectorization(QObject *parent = nullptr);
@@ -172,6 +269,68 @@ signals:
 
 
 
+class VectorSimplification : public VectorTransforms {
+    Q_OBJECT;
+    Q_PROPERTY(QString method MEMBER m_method NOTIFY methodChanged);
+    Q_PROPERTY(double tolerance MEMBER m_tolerance NOTIFY toleranceChanged);
+    Q_PROPERTY(bool graph_units MEMBER m_graph_units NOTIFY graphUnitsChanged);
+
+private:
+    QString m_method;
+    double m_tolerance;
+    bool m_graph_units;
+
+    // points are given in tolerance units, result holds indexes of kept points
+    QVector<int> douglasPeucker(const QVector<QPointF> &points, double tolerance);
+    QVector<int> visvalingam(const QVector<QPointF> &points, double tolerance);
+    QLinkedList<QPoint> simplifyCurve(const QLinkedList<QPoint> &curve);
+
+public:
+    explicit VectorSimplification(double tolerance = 1.5, QObject *parent = nullptr);
+
+    virtual VectorizationProduct processData(const VectorizationProduct &vp);
+    virtual ~VectorSimplification();
+
+signals:
+    void methodChanged(QString);
+    void toleranceChanged(double);
+    void graphUnitsChanged(bool);
+};
+
+
+
+// samples contours on uniform x grid of graph units, result arrays go out through samplesReady
+// product holds the same pieces rounded to pixels, so chart shows what was sampled
+class VectorResampling : public VectorTransforms {
+    Q_OBJECT;
+    Q_PROPERTY(double step MEMBER m_step NOTIFY stepChanged);
+    Q_PROPERTY(QString method MEMBER m_method NOTIFY methodChanged);
+
+private:
+    double m_step;
+    QString m_method;
+
+    // x-monotone pieces of contour in graph units, x made increasing, equal x merged
+    QVector<QVector<QPointF>> monotonePieces(const QLinkedList<QPoint> &curve);
+    void sampleLinear(const QVector<QPointF> &piece, double x0, double step, int count, double *x, double *y);
+    void sampleSpline(const QVector<QPointF> &piece, double x0, double step, int count, double *x, double *y);
+
+public:
+    explicit VectorResampling(double step = 1, QObject *parent = nullptr);
+
+    virtual VectorizationProduct processData(const VectorizationProduct &vp);
+    virtual ~VectorResampling();
+
+signals:
+    void stepChanged(double);
+    void methodChanged(QString);
+    void samplesReady(ResampledResult);
+    // sample count did not fit int offsets, step was doubled until it did
+    void stepEnlarged(double);
+};
+
+
+
 // GraphProcessor
 
 class GraphProcessor : public QObject {
@@ -180,18 +339,25 @@ private:
     QWidget *prop_group_widget;
     Vectorization *vectorization_filter;
     QList<VectorTransforms*> vector_trans_filters;
+    GraphTransform graph_transform;
 
 public:
     explicit GraphProcessor(QWidget *prop_group_widget, QObject *parent = nullptr);
     ~GraphProcessor();
 
     void setMiddleware(Vectorization *vectorization_filter, const QList<VectorTransforms*> &vector_trans_filters);
+    // stages with their settings, result cache key part
+    QByteArray chainSignature();
+    // false when a used stage has outputs besides product, which result cache does not keep
+    bool isCacheable();
 
 public slots:
-    void processGraph(const QImage &image);
+    // offset moves result points from processed region to full image coordinates
+    void processGraph(const QImage &image, const QPoint &offset);
+    void setGraphTransform(const GraphTransform &graph_transform);
 
 signals:
-    void resultReady(VectorizationProduct);
+    void resultReady(VectorizationResult);
     void startCalculating(int, QString); // count of filters
     void currentFilter(int, QString); // number, name
     void finishCalculating();
@@ -221,7 +387,13 @@ class LinearVectorizationGraph : public VectorizationGraph {
 private:
     int m_square_size;
 
-    GraphPoint* vectorizeCurve(const QImage &image, bool **used_field, const QPoint &start);
+    // square perimeter walk as pixel shifts and plane offsets, built for square size and image width
+    QVector<QPoint> perimeter_shifts;
+    QVector<int> perimeter_offsets;
+    int perimeter_square_size, perimeter_width;
+
+    void buildPerimeter(int width);
+    void vectorizeCurve(const uchar *foreground, uchar *used_field, int width, int height, const QPoint &start, GraphStoreBuilder &graph);
 
 public:
     explicit LinearVectorizationGraph(QObject *parent = nullptr);
@@ -248,10 +420,10 @@ public:
     void setMiddleware(VectorizationGraph *vectorization_filter);
 
 public slots:
-    void processGraph(const QImage &image);
+    void processGraph(const QImage &image, const QPoint &offset);
 
 signals:
-    void resultReady(VectorizationProductGraph);
+    void resultReady(VectorizationResultGraph);
     void startCalculating(int, QString); // count of filters
     void currentFilter(int, QString); // number, name
     void finishCalculating();
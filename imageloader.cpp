@@ -0,0 +1,32 @@
+#include "imageloader.h"
+
+QSize ImageLoader::imageSize(const QString &filename) {
+    QImageReader reader(filename);
+    return reader.size();
+}
+
+QImage ImageLoader::readPreview(const QString &filename, int max_side) {
+    QImageReader reader(filename);
+    reader.setAllocationLimit(0);
+    QSize size = reader.size();
+    if (size.isValid() && std::max(size.width(), size.height()) > max_side) {
+        reader.setScaledSize(size.scaled(max_side, max_side, Qt::KeepAspectRatio));
+    }
+    return reader.read();
+}
+
+QImage ImageLoader::readFull(const QString &filename) {
+    QImageReader reader(filename);
+    reader.setAllocationLimit(0); // scans may exceed default 256 MB limit
+    return reader.read();
+}
+
+QImage ImageLoader::readRegion(const QString &filename, const QRect &region) {
+    QImageReader reader(filename);
+    reader.setAllocationLimit(0);
+    QRect clip = region.intersected(QRect(QPoint(0, 0), reader.size()));
+    if (clip.isEmpty())
+        return QImage();
+    reader.setClipRect(clip);
+    return reader.read();
+}
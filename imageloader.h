@@ -0,0 +1,20 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <QImage>
+#include <QImageReader>
+#include <QString>
+#include <QSize>
+#include <QRect>
+
+// image decoding with QImageReader, functions are safe to call from worker threads
+namespace ImageLoader {
+    QSize imageSize(const QString &filename);
+    // decodes image scaled down to fit max_side, formats like jpeg decode directly at reduced size
+    QImage readPreview(const QString &filename, int max_side);
+    QImage readFull(const QString &filename);
+    // decodes only region of image (in full image pixels)
+    QImage readRegion(const QString &filename, const QRect &region);
+}
+
+#endif // IMAGELOADER_H
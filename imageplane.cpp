@@ -0,0 +1,108 @@
+#include "imageplane.h"
+
+#include <algorithm>
+
+ImagePlane::ImagePlane() : plane_type(Null), plane_width(0), plane_height(0), mask_stride(0), label_count(0) {}
+
+ImagePlane::ImagePlane(Type type, int width, int height) : plane_type(type), plane_width(width), plane_height(height), mask_stride(0), label_count(0) {}
+
+ImagePlane::ImagePlane(const QImage &image) : ImagePlane(image.isNull() ? Null : Rgb, image.width(), image.height()) {
+    rgb = image;
+}
+
+ImagePlane ImagePlane::values(int width, int height) {
+    ImagePlane plane(Value, width, height);
+    plane.value_data.resize(width * height);
+    // shown as grayscale unless stage sets own palette
+    plane.palette.resize(256);
+    for (int i = 0; i < 256; i++) {
+        plane.palette[i] = qRgb(i, i, i);
+    }
+    return plane;
+}
+
+ImagePlane ImagePlane::labels(int width, int height, int label_count) {
+    ImagePlane plane(Labels, width, height);
+    plane.label_data.resize(width * height);
+    plane.label_count = label_count;
+    return plane;
+}
+
+ImagePlane ImagePlane::mask(int width, int height) {
+    ImagePlane plane(Mask, width, height);
+    plane.mask_stride = (width + 63) / 64;
+    plane.mask_data.fill(0, plane.mask_stride * height);
+    plane.palette = {qRgb(0, 0, 0), qRgb(255, 255, 255)};
+    return plane;
+}
+
+void ImagePlane::setMaskBit(int x, int y, bool bit) {
+    quint64 &word = mask_data[y * mask_stride + (x >> 6)];
+    word = (word & ~(1ull << (x & 63))) | ((quint64)bit << (x & 63));
+}
+
+QVector<float> ImagePlane::valuePlane() const {
+    QVector<float> result(plane_width * plane_height);
+    if (plane_type == Rgb) {
+        QImage rgb32 = rgb.convertToFormat(QImage::Format_RGB32);
+        for (int y = 0; y < plane_height; y++) {
+            const QRgb *line = reinterpret_cast<const QRgb*>(rgb32.constScanLine(y));
+            for (int x = 0; x < plane_width; x++) {
+                result[y * plane_width + x] = std::max({qRed(line[x]), qGreen(line[x]), qBlue(line[x])});
+            }
+        }
+    }
+    else if (plane_type == Value) {
+        // heat map palette is for display only, next stages threshold the magnitude itself
+        result = value_data;
+    }
+    else if (plane_type == Labels) {
+        // labels are shown with full brightness hues
+        for (int k = 0; k < plane_width * plane_height; k++) {
+            result[k] = label_data[k] > 0 ? 255 : 0;
+        }
+    }
+    else if (plane_type == Mask) {
+        float bit_values[2];
+        for (int b = 0; b < 2; b++) {
+            bit_values[b] = std::max({qRed(palette[b]), qGreen(palette[b]), qBlue(palette[b])});
+        }
+        for (int y = 0; y < plane_height; y++) {
+            for (int x = 0; x < plane_width; x++) {
+                result[y * plane_width + x] = bit_values[maskBit(x, y)];
+            }
+        }
+    }
+    return result;
+}
+
+QImage ImagePlane::toImage() const {
+    if (plane_type == Rgb || plane_type == Null)
+        return rgb;
+
+    QImage result(plane_width, plane_height, QImage::Format_RGB32);
+    QVector<QRgb> label_colors;
+    if (plane_type == Labels) {
+        label_colors.append(qRgb(0, 0, 0));
+        for (int l = 1; l <= label_count; l++) {
+            label_colors.append(QColor::fromHsvF(1.0 / (label_count + 1) * l, 1.0, 1.0).rgb());
+        }
+    }
+
+    for (int y = 0; y < plane_height; y++) {
+        QRgb *line = reinterpret_cast<QRgb*>(result.scanLine(y));
+        for (int x = 0; x < plane_width; x++) {
+            int k = y * plane_width + x;
+            if (plane_type == Value) {
+                line[x] = palette[std::min(255, std::max(0, (int)value_data[k]))];
+            }
+            else if (plane_type == Labels) {
+                line[x] = label_colors[std::min(label_data[k], (quint32)label_count)];
+            }
+            else {
+                line[x] = palette[maskBit(x, y)];
+            }
+        }
+    }
+    return result;
+}
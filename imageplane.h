@@ -0,0 +1,61 @@
+#ifndef IMAGEPLANE_H
+#define IMAGEPLANE_H
+
+#include <QImage>
+#include <QColor>
+#include <QVector>
+
+// per pixel data passed between image stages
+// stages keep their native representation, QImage is built only for display and export
+class ImagePlane {
+public:
+    // Rgb - colors, Value - float values in 0..255 range, Labels - uint32 area labels, Mask - one bit per pixel
+    enum Type {Null, Rgb, Value, Labels, Mask};
+
+private:
+    Type plane_type;
+    int plane_width, plane_height;
+
+    QImage rgb;
+    QVector<float> value_data;
+    QVector<quint32> label_data;
+    QVector<quint64> mask_data;
+    int mask_stride; // 64 bit words per row
+
+    // metadata used when plane is shown as image
+    QVector<QRgb> palette; // Value - 256 colors of quantized value, Mask - 2 colors
+    int label_count; // Labels - labels are 1..label_count, 0 is unlabeled
+
+    ImagePlane(Type type, int width, int height);
+
+public:
+    ImagePlane();
+    explicit ImagePlane(const QImage &image);
+    static ImagePlane values(int width, int height);
+    static ImagePlane labels(int width, int height, int label_count);
+    static ImagePlane mask(int width, int height);
+
+    Type type() const { return plane_type; }
+    bool isNull() const { return plane_type == Null; }
+    int width() const { return plane_width; }
+    int height() const { return plane_height; }
+
+    const QImage& image() const { return rgb; }
+    float* valueData() { return value_data.data(); }
+    const float* valueData() const { return value_data.constData(); }
+    quint32* labelData() { return label_data.data(); }
+    const quint32* labelData() const { return label_data.constData(); }
+    bool maskBit(int x, int y) const { return (mask_data[y * mask_stride + (x >> 6)] >> (x & 63)) & 1; }
+    void setMaskBit(int x, int y, bool bit);
+
+    void setPalette(const QVector<QRgb> &palette) { this->palette = palette; }
+    int labelCount() const { return label_count; }
+
+    // values of any plane type in 0..255 range
+    // Rgb and Mask give value of color shown for pixel, Labels give 255 for labeled pixels,
+    // Value planes give their raw values, palette is not applied
+    QVector<float> valuePlane() const;
+    QImage toImage() const;
+};
+
+#endif // IMAGEPLANE_H
@@ -1,4 +1,7 @@
 #include "imagepreprocess.h"
+#include "resultcache.h"
+
+#include <cstring>
 
 // ImagePreprocess
 void ImagePreprocess::generateWidget(const QList<QMap<QString, QVariant>> &widget_properties) {
@@ -36,7 +39,7 @@ void ImagePreprocess::generateWidget(const QList<QMap<QString, QVariant>> &widge
     FormGenerator::generateWidget(interface_widget, layout, widget_properties);
 }
 
-ImagePreprocess::ImagePreprocess(QObject *parent) : FormGenerator(parent), interface_widget(nullptr), use(true) {}
+ImagePreprocess::ImagePreprocess(QObject *parent) : FormGenerator(parent), interface_widget(nullptr), use(true), fused_next(nullptr), input_fused(false) {}
 
 ImagePreprocess::~ImagePreprocess() {
     if (interface_widget != nullptr)
@@ -47,6 +50,22 @@ void ImagePreprocess::useFilter(bool use) {
     this->use = use;
 }
 
+ImagePlane ImagePreprocess::processPlane(const ImagePlane &plane) {
+    return ImagePlane(processImage(plane.toImage()));
+}
+
+QRgb ImagePreprocess::fusedColor(QRgb color) {
+    if (fused_lut.isEmpty())
+        return color;
+    uchar value = fused_lut[std::max({qRed(color), qGreen(color), qBlue(color)})];
+    return qRgb(value, value, value);
+}
+
+float ImagePreprocess::fusedValue(float value) {
+    return fused_next == nullptr ? value : fused_next->inputValue(value);
+}
+
+
 
 // MonochromeGradientImage
 MonochromeGradientImage::MonochromeGradientImage(QObject *parent) : ImagePreprocess(parent) {
@@ -64,33 +83,52 @@ MonochromeGradientImage::MonochromeGradientImage(QObject *parent) : ImagePreproc
 }
 
 QImage MonochromeGradientImage::processImage(const QImage &image) {
-    int step = 1;
-
-    QImage result(image);
-    for (int y = 0; y < image.height() - step; y++) {
-        for (int x = 0; x < image.width() - step; x++) {
-
-            QColor pixel = image.pixelColor(x, y);
-            QColor pixel_x = image.pixelColor(x + step, y);
-            QColor pixel_y = image.pixelColor(x, y + step);
-            int avg = (pixel.red() + pixel.green() + pixel.blue()) / 3;
-            int avg_x = (pixel_x.red() + pixel_x.green() + pixel_x.blue()) / 3;
-            int avg_y = (pixel_y.red() + pixel_y.green() + pixel_y.blue()) / 3;
-            int gradient = sqrt((avg_x - avg) * (avg_x - avg) + (avg_y - avg) * (avg_y - avg));
-
-            int set_avg;
-            if (gradient >= m_threshold) {
-                set_avg = 0;
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    int width = rgb.width(), height = rgb.height();
+    QVector<QPair<int, int>> bands = ImageAlgorithms::rowBands(height);
+
+    // luminance plane is computed once, every pixel is read by three gradients
+    QVector<uchar> luminance(width * height);
+    QtConcurrent::blockingMap(bands, [&](const QPair<int, int> &band) {
+        for (int y = band.first; y < band.second; y++) {
+            const QRgb *line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y));
+            uchar *lum_line = luminance.data() + y * width;
+            for (int x = 0; x < width; x++) {
+                lum_line[x] = (qRed(line[x]) + qGreen(line[x]) + qBlue(line[x])) / 3;
             }
-            else {
-                set_avg = 255;
+        }
+    });
+
+    // squared gradient is compared with squared threshold, loops are branchless so compiler vectorizes them
+    int threshold_2 = m_threshold * m_threshold;
+    uchar edge_value = qRed(fusedColor(qRgb(0, 0, 0))), flat_value = qRed(fusedColor(qRgb(255, 255, 255)));
+    QImage result(width, height, QImage::Format_Grayscale8);
+    uchar *result_bits = result.bits();
+    qsizetype bytes_per_line = result.bytesPerLine();
+    QtConcurrent::blockingMap(bands, [&](const QPair<int, int> &band) {
+        for (int y = band.first; y < band.second; y++) {
+            uchar *out = result_bits + y * bytes_per_line;
+            if (y == height - 1 || width < 2) {
+                // last row and column have no forward neighbours
+                memset(out, flat_value, width);
+                continue;
             }
-            result.setPixelColor(x, y, QColor(set_avg, set_avg, set_avg));
+            const uchar *lum = luminance.constData() + y * width;
+            const uchar *lum_next = lum + width;
+            for (int x = 0; x < width - 1; x++) {
+                int gx = lum[x + 1] - lum[x], gy = lum_next[x] - lum[x];
+                out[x] = gx * gx + gy * gy >= threshold_2 ? edge_value : flat_value;
+            }
+            out[width - 1] = flat_value;
         }
-    }
+    });
     return result;
 }
 
+int MonochromeGradientImage::halo() {
+    return 1;
+}
+
 MonochromeGradientImage::~MonochromeGradientImage() {}
 
 
@@ -98,6 +136,7 @@ MonochromeGradientImage::~MonochromeGradientImage() {}
 GaussianBlur::GaussianBlur(QObject *parent) : ImagePreprocess(parent) {
     m_sigma = 1.4f;
     m_size = 5;
+    m_method = "direct";
 
     group_name = "Gaussian blur";
     generateWidget(QList<QMap<QString, QVariant>>(
@@ -107,32 +146,37 @@ GaussianBlur::GaussianBlur(QObject *parent) : ImagePreprocess(parent) {
         },
         {
             std::pair<QString, QVariant>("name", "size")
+        },
+        {
+            std::pair<QString, QVariant>("name", "method"),
+            std::pair<QString, QVariant>("field_type", "list"),
+            std::pair<QString, QVariant>("variants", QStringList({"direct", "recursive", "box"}))
         }
     }));
 }
 
 QImage GaussianBlur::processImage(const QImage &image) {
-    double **matrix;
-
-    matrix = new double*[m_size];
-    for (int i = 0; i < m_size; i++) {
-        matrix[i] = new double[m_size];
-    }
-
+    if (m_method == "recursive")
+        return ImageAlgorithms::recursiveGaussian(image, m_sigma);
+    if (m_method == "box")
+        return ImageAlgorithms::boxGaussian(image, m_sigma);
+
+    // kernel is built once per sigma and size
+    const QVector<double> kernel = KernelRegistry::gaussianKernel(m_sigma, m_size);
+    QVector<const double*> matrix(m_size);
     for (int j = 0; j < m_size; j++) {
-        for (int i = 0; i < m_size; i++) {
-            matrix[j][i] = MathFunctions::gaussian2d(i - m_size / 2, j - m_size / 2, m_sigma);
-        }
+        matrix[j] = kernel.constData() + j * m_size;
     }
 
-    QImage result = ImageAlgorithms::convolving(image, matrix, m_size);
-
-    for (int i = 0; i < m_size; i++) {
-        delete [] matrix[i];
-    }
-    delete [] matrix;
+    return ImageAlgorithms::convolving(image, matrix.constData(), m_size);
+}
 
-    return result;
+int GaussianBlur::halo() {
+    // recursive filter has infinite response, 3 sigma holds almost all of it
+    // three boxes reach sum of their radii, which is close to 3 sigma too
+    if (m_method == "recursive" || m_method == "box")
+        return (int)ceil(3 * m_sigma);
+    return m_size / 2;
 }
 
 GaussianBlur::~GaussianBlur() {}
@@ -141,6 +185,8 @@ GaussianBlur::~GaussianBlur() {}
 // CannyFilter
 
 CannyFilter::CannyFilter(QObject *parent) : ImagePreprocess(parent) {
+    m_filter = "prewitt_3";
+    kernel_id = KernelRegistry::Prewitt3;
     m_supression = true;
     m_threshold_low = 15;
     m_threshold_high = 20;
@@ -152,7 +198,7 @@ CannyFilter::CannyFilter(QObject *parent) : ImagePreprocess(parent) {
         {
             std::pair<QString, QVariant>("name", "filter"),
             std::pair<QString, QVariant>("field_type", "list"),
-            std::pair<QString, QVariant>("variants", QStringList({"prewitt_3", "prewitt_5", "prewitt_7", "sobel", "tpo_5", "tpo_7"}))
+            std::pair<QString, QVariant>("variants", KernelRegistry::gradientKernelNames())
         },
         {
             std::pair<QString, QVariant>("name", "supression")
@@ -174,252 +220,57 @@ CannyFilter::CannyFilter(QObject *parent) : ImagePreprocess(parent) {
 }
 
 QImage CannyFilter::processImage(const QImage &image) {
-    QImage result(image);
-
-    double matrix_x_prewitt_3[9] = {
-        -1, 0, 1,
-        -1, 0, 1,
-        -1, 0, 1
-    };
-
-    double matrix_y_prewitt_3[9] = {
-        -1, -1, -1,
-        0, 0, 0,
-        1, 1, 1
-    };
-
-    double matrix_x_prewitt_5[25] = {
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-    };
-
-    double matrix_y_prewitt_5[25] = {
-        -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1,
-         0,  0,  0,  0,  0,
-         1,  1,  1,  1,  1,
-         1,  1,  1,  1,  1
-    };
+    const GradientKernel &kernel = KernelRegistry::gradientKernel(kernel_id);
+    const double *matrix_x = kernel.x.constData(), *matrix_y = kernel.y.constData();
+    int matrix_size = kernel.size, weight_divider = kernel.weight_divider;
+    int width = image.width(), height = image.height();
 
-    double matrix_x_prewitt_7[49] = {
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-    };
-
-    double matrix_y_prewitt_7[49] = {
-        -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1,
-         0,  0,  0,  0,  0,  0,  0,
-         1,  1,  1,  1,  1,  1,  1,
-         1,  1,  1,  1,  1,  1,  1,
-         1,  1,  1,  1,  1,  1,  1
-    };
-
-    double matrix_x_sobel[9] = {
-        -1, 0, 1,
-        -2, 0, 2,
-        -1, 0, 1
-    };
-
-    double matrix_y_sobel[9] = {
-        -1, -2, -1,
-        0, 0, 0,
-        1, 2, 1
-    };
-
-    double matrix_x_tpo_5[25] = {
-        -1, -1, 0, 1, 1,
-        -1, -2, 0, 2, 1,
-        -1, -3, 0, 3, 1,
-        -1, -2, 0, 2, 1,
-        -1, -1, 0, 1, 1
-    };
-
-    double matrix_y_tpo_5[25] = {
-        -1, -1, -1, -1, -1,
-        -1, -2, -3, -2, -1,
-         0,  0,  0,  0,  0,
-         1,  2,  3,  2,  1,
-         1,  1,  1,  1,  1
-    };
-
-    double matrix_x_tpo_7[49] = {
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -2, -2, 0, 2, 2, 1,
-        -1, -2, -3, 0, 3, 2, 1,
-        -1, -2, -3, 0, 3, 2, 1,
-        -1, -2, -3, 0, 3, 2, 1,
-        -1, -2, -2, 0, 2, 2, 1,
-        -1, -1, -1, 0, 1, 1, 1
-    };
-
-    double matrix_y_tpo_7[49] = {
-        -1, -1, -1, -1, -1, -1, -1,
-        -1, -2, -2, -2, -2, -2, -1,
-        -1, -2, -3, -3, -3, -2, -1,
-         0,  0,  0,  0,  0,  0,  0,
-         1,  2,  3,  3,  3,  2,  1,
-         1,  2,  2,  2,  2,  2,  1,
-         1,  1,  1,  1,  1,  1,  1
-    };
-
-    double *matrix_x = matrix_x_prewitt_3, *matrix_y = matrix_y_prewitt_3;
-    int matrix_size = 3, weight_divider = 3;
-
-    if (m_filter == "prewitt_3") {
-        matrix_x = matrix_x_prewitt_3;
-        matrix_y = matrix_y_prewitt_3;
-        matrix_size = 3;
-        weight_divider = 3;
-    }
-    if (m_filter == "prewitt_5") {
-        matrix_x = matrix_x_prewitt_5;
-        matrix_y = matrix_y_prewitt_5;
-        matrix_size = 5;
-        weight_divider = 10;
-    }
-    if (m_filter == "prewitt_7") {
-        matrix_x = matrix_x_prewitt_7;
-        matrix_y = matrix_y_prewitt_7;
-        matrix_size = 7;
-        weight_divider = 21;
-    }
-    else if (m_filter == "sobel") {
-        matrix_x = matrix_x_sobel;
-        matrix_y = matrix_y_sobel;
-        matrix_size = 3;
-        weight_divider = 4;
-    }
-    else if (m_filter == "tpo_5") {
-        matrix_x = matrix_x_tpo_5;
-        matrix_y = matrix_y_tpo_5;
-        matrix_size = 5;
-        weight_divider = 15;
-    }
-    else if (m_filter == "tpo_7") {
-        matrix_x = matrix_x_tpo_7;
-        matrix_y = matrix_y_tpo_7;
-        matrix_size = 7;
-        weight_divider = 34;
-    }
-
-    // init
-    double **values_x, **values_y;
-    GradientVector **gf_1, **gf_2;
-    int **dtf, **dtf2;
-    values_x = new double*[image.height()];
-    values_y = new double*[image.height()];
-    gf_1 = new GradientVector*[image.height()];
-    gf_2 = new GradientVector*[image.height()];
-    dtf = new int*[image.height()];
-    dtf2 = new int*[image.height()];
-    for (int i = 0; i < image.height(); i++) {
-        values_x[i] = new double[image.width()];
-        values_y[i] = new double[image.width()];
-        gf_1[i] = new GradientVector[image.width()];
-        gf_2[i] = new GradientVector[image.width()];
-        dtf[i] = new int[image.width()];
-        dtf2[i] = new int[image.width()];
-    }
-
-    // find gradient
-    ImageAlgorithms::convolving(values_x, image.width(), image.height(), image, matrix_x, matrix_size);
-    ImageAlgorithms::convolving(values_y, image.width(), image.height(), image, matrix_y, matrix_size);
-
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            gf_1[j][i].set(values_x[j][i], values_y[j][i]);
-            gf_2[j][i] = gf_1[j][i];
-        }
-    }
+    // gradient field is kept as magnitude and orientation bin planes, 3 bytes per pixel
+    QVector<quint16> magnitude(width * height);
+    QVector<uchar> orientation(width * height);
+    ImageAlgorithms::gradientPlanes(image, matrix_x, matrix_y, matrix_size, magnitude.data(), orientation.data());
 
     // Gradient magnitude thresholding or lower bound cut-off suppression
+    QVector<quint16> suppressed(magnitude);
     if (m_supression) {
-        for (int j = 1; j < image.height() - 1; j++) {
-            for (int i = 1; i < image.width() - 1; i++) {
-                GradientVector gv0, gv1, gv2;
-                gv0 = gf_1[j][i];
-                gv1 = gf_1[j + gv0.getRotation().y()][i + gv0.getRotation().x()];
-                gv2 = gf_1[j - gv0.getRotation().y()][i - gv0.getRotation().x()];
-                if (! (gv0.len() > gv1.len() && gv0.len() > gv2.len())) {
-                    gf_2[j][i].set(0, 0);
-                }
-            }
-        }
-    }
-
-    // Double threshold
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            dtf[j][i] = gf_2[j][i].len() > m_threshold_low * weight_divider ? (gf_2[j][i].len() < m_threshold_high * weight_divider ? 1 : 2) : 0;
-        }
+        ImageAlgorithms::nonMaximumSuppression(magnitude.constData(), orientation.constData(), width, height, suppressed.data());
     }
 
-
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            dtf2[j][i] = dtf[j][i];
-        }
-    }
-    // Edge tracking by hysteresis
-    if (m_hysteresis) {
-        for (int j = 1; j < image.height() - 1; j++) {
-            for (int i = 1; i < image.width() - 1; i++) {
-                //result.setPixelColor(i, j, QColor(127 * dtf[j][i], 127 * dtf[j][i], 127 * dtf[j][i]));
-                if (dtf[j][i] == 1) {
-                    bool found = false;
-                    for (int y = j - 1; y <= j + 1; y++) {
-                        for (int x = i - 1; x <= i + 1; x++) {
-                            if (!(x == i && y == j) && dtf[y][x] == 2)
-                                found = true;
-                        }
-                    }
-                    if (! found)
-                        dtf2[j][i] = 0;
-                }
-            }
-        }
-    }
+    // Double threshold and edge tracking by hysteresis
+    QVector<uchar> dtf2(width * height);
+    ImageAlgorithms::hysteresisThreshold(suppressed.constData(), width, height, m_threshold_low * weight_divider, m_threshold_high * weight_divider, m_hysteresis, dtf2.data());
 
     // monochromize
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            result.setPixelColor(i, j, QColor(dtf2[j][i] != 0 ? (dtf2[j][i] == 1 ? 128 : 255) : 0, dtf2[j][i] != 0 ? (dtf2[j][i] == 1 ? 128 : 255) : 0, dtf2[j][i] != 0 ? (dtf2[j][i] == 1 ? 128 : 255) : 0));
+    QImage result(width, height, QImage::Format_RGB32);
+    const QRgb colors[3] = {fusedColor(qRgb(0, 0, 0)), fusedColor(qRgb(128, 128, 128)), fusedColor(qRgb(255, 255, 255))};
+    for (int j = 0; j < height; j++) {
+        QRgb *line = reinterpret_cast<QRgb*>(result.scanLine(j));
+        for (int i = 0; i < width; i++) {
+            line[i] = colors[dtf2[j * width + i]];
         }
     }
 
-    // destruct
-    for (int i = 0; i < image.height(); i++) {
-        delete [] values_x[i];
-        delete [] values_y[i];
-        delete [] gf_1[i];
-        delete [] gf_2[i];
-        delete [] dtf[i];
-        delete [] dtf2[i];
-    }
-    delete [] values_x;
-    delete [] values_y;
-    delete [] gf_1;
-    delete [] gf_2;
-    delete [] dtf;
-    delete [] dtf2;
-
     return result;
 }
 
+void CannyFilter::setFilter(const QString &filter) {
+    m_filter = filter;
+    kernel_id = KernelRegistry::gradientKernelId(filter);
+    emit filterChanged(m_filter);
+}
+
+int CannyFilter::halo() {
+    // suppression and hysteresis look one pixel further each
+    return KernelRegistry::gradientKernel(kernel_id).size / 2 + 2;
+}
+
 CannyFilter::~CannyFilter() {}
 
 
 // ColorGradientField
 ColorGradientField::ColorGradientField(QObject *parent) : ImagePreprocess(parent) {
+    m_filter = "prewitt_3";
+    kernel_id = KernelRegistry::Prewitt3;
     m_max_border = true;
     m_grayscale = true;
 
@@ -429,7 +280,7 @@ ColorGradientField::ColorGradientField(QObject *parent) : ImagePreprocess(parent
         {
             std::pair<QString, QVariant>("name", "filter"),
             std::pair<QString, QVariant>("field_type", "list"),
-            std::pair<QString, QVariant>("variants", QStringList({"prewitt_3", "prewitt_5", "prewitt_7", "sobel", "tpo_5", "tpo_7"}))
+            std::pair<QString, QVariant>("variants", KernelRegistry::gradientKernelNames())
         },
         {
             std::pair<QString, QVariant>("name", "max_border")
@@ -441,215 +292,221 @@ ColorGradientField::ColorGradientField(QObject *parent) : ImagePreprocess(parent
 }
 
 QImage ColorGradientField::processImage(const QImage &image) {
-    QImage result(image);
-
-    double matrix_x_prewitt_3[9] = {
-        -1, 0, 1,
-        -1, 0, 1,
-        -1, 0, 1
-    };
-
-    double matrix_y_prewitt_3[9] = {
-        -1, -1, -1,
-        0, 0, 0,
-        1, 1, 1
-    };
-
-    double matrix_x_prewitt_5[25] = {
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-        -1, -1, 0, 1, 1,
-    };
-
-    double matrix_y_prewitt_5[25] = {
-        -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1,
-         0,  0,  0,  0,  0,
-         1,  1,  1,  1,  1,
-         1,  1,  1,  1,  1
-    };
-
-    double matrix_x_prewitt_7[49] = {
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -1, -1, 0, 1, 1, 1,
-    };
+    return processPlane(ImagePlane(image)).toImage();
+}
 
-    double matrix_y_prewitt_7[49] = {
-        -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1,
-        -1, -1, -1, -1, -1, -1, -1,
-         0,  0,  0,  0,  0,  0,  0,
-         1,  1,  1,  1,  1,  1,  1,
-         1,  1,  1,  1,  1,  1,  1,
-         1,  1,  1,  1,  1,  1,  1
-    };
+ImagePlane ColorGradientField::processPlane(const ImagePlane &source) {
+    const GradientKernel &kernel = KernelRegistry::gradientKernel(kernel_id);
+    int width = source.width(), height = source.height();
+    int half = kernel.size / 2;
 
-    double matrix_x_sobel[9] = {
-        -1, 0, 1,
-        -2, 0, 2,
-        -1, 0, 1
-    };
+    // convolution is linear, so gradient of channel mean equals mean of channel gradients
+    QVector<float> plane = source.type() == ImagePlane::Rgb ? ImageAlgorithms::grayPlane(source.image()) : source.valuePlane();
+    QVector<float> magnitude(width * height, 0);
 
-    double matrix_y_sobel[9] = {
-        -1, -2, -1,
-        0, 0, 0,
-        1, 2, 1
+    // find gradient, every band reduces min and max of its rows
+    struct Band {
+        int begin, end;
+        float min_len, max_len;
     };
+    QVector<Band> bands;
+    for (const QPair<int, int> &rows : ImageAlgorithms::rowBands(height)) {
+        bands.append({rows.first, rows.second, 0, 0});
+    }
+    QtConcurrent::blockingMap(bands, [&](Band &band) {
+        float min_len = -1, max_len = -1;
+        for (int y = band.begin; y < band.end; y++) {
+            for (int x = 0; x < width; x++) {
+                // border without full kernel support keeps zero length
+                float len = 0;
+                if (x > half && y > half && x < width - half && y < height - half) {
+                    double gx = 0, gy = 0;
+                    for (int j = 0; j < kernel.size; j++) {
+                        const float *line = plane.constData() + (y + j - half) * width + x - half;
+                        for (int i = 0; i < kernel.size; i++) {
+                            gx += line[i] * kernel.x[j * kernel.size + i];
+                            gy += line[i] * kernel.y[j * kernel.size + i];
+                        }
+                    }
+                    len = fabs(gx) + fabs(gy);
+                }
+                magnitude[y * width + x] = len;
+                if (min_len < 0 || len < min_len) min_len = len;
+                if (max_len < 0 || len > max_len) max_len = len;
+            }
+        }
+        band.min_len = min_len;
+        band.max_len = max_len;
+    });
 
-    double matrix_x_tpo_5[25] = {
-        -1, -1, 0, 1, 1,
-        -1, -2, 0, 2, 1,
-        -1, -3, 0, 3, 1,
-        -1, -2, 0, 2, 1,
-        -1, -1, 0, 1, 1
-    };
+    float min_len = -1, max_len = -1;
+    for (const Band &band : bands) {
+        if (band.begin == band.end)
+            continue;
+        if (min_len < 0 || band.min_len < min_len) min_len = band.min_len;
+        if (max_len < 0 || band.max_len > max_len) max_len = band.max_len;
+    }
 
-    double matrix_y_tpo_5[25] = {
-        -1, -1, -1, -1, -1,
-        -1, -2, -3, -2, -1,
-         0,  0,  0,  0,  0,
-         1,  2,  3,  2,  1,
-         1,  1,  1,  1,  1
-    };
+    // length is kept as float value, lut is used only when result is shown
+    QVector<QRgb> lut(256);
+    for (int q = 0; q < 256; q++) {
+        if (m_grayscale) {
+            lut[q] = qRgb(q, q, q);
+        }
+        else if (q < 128) {
+            int v = q * 255 / 127;
+            lut[q] = qRgb(0, v, 255 - v);
+        }
+        else {
+            int v = (q - 128) * 255 / 127;
+            lut[q] = qRgb(v, 255 - v, 0);
+        }
+    }
+    float value_scale = max_len > min_len ? 255 / (max_len - min_len) : 0;
+
+    // border gets top value, shown as white or red
+    // input lut of next stage is applied here, so segmentation threshold costs no extra pass
+    float border_value = fusedValue(255);
+    ImagePlane result = ImagePlane::values(width, height);
+    result.setPalette(lut);
+    float *values = result.valueData();
+    QtConcurrent::blockingMap(bands, [&](Band &band) {
+        for (int y = band.begin; y < band.end; y++) {
+            const float *len_line = magnitude.constData() + y * width;
+            float *value_line = values + y * width;
+            bool border_row = y < half + 1 || y >= height - (half + 1);
+            for (int x = 0; x < width; x++) {
+                value_line[x] = fusedValue((len_line[x] - min_len) * value_scale);
+                if (m_max_border && (border_row || x < half + 1 || x >= width - (half + 1)))
+                    value_line[x] = border_value;
+            }
+        }
+    });
 
-    double matrix_x_tpo_7[49] = {
-        -1, -1, -1, 0, 1, 1, 1,
-        -1, -2, -2, 0, 2, 2, 1,
-        -1, -2, -3, 0, 3, 2, 1,
-        -1, -2, -3, 0, 3, 2, 1,
-        -1, -2, -3, 0, 3, 2, 1,
-        -1, -2, -2, 0, 2, 2, 1,
-        -1, -1, -1, 0, 1, 1, 1
-    };
+    return result;
+}
 
-    double matrix_y_tpo_7[49] = {
-        -1, -1, -1, -1, -1, -1, -1,
-        -1, -2, -2, -2, -2, -2, -1,
-        -1, -2, -3, -3, -3, -2, -1,
-         0,  0,  0,  0,  0,  0,  0,
-         1,  2,  3,  3,  3,  2,  1,
-         1,  2,  2,  2,  2,  2,  1,
-         1,  1,  1,  1,  1,  1,  1
-    };
+void ColorGradientField::setFilter(const QString &filter) {
+    m_filter = filter;
+    kernel_id = KernelRegistry::gradientKernelId(filter);
+    emit filterChanged(m_filter);
+}
 
-    double *matrix_x = matrix_x_prewitt_3, *matrix_y = matrix_y_prewitt_3;
-    int matrix_size = 3;
+int ColorGradientField::halo() {
+    return KernelRegistry::gradientKernel(kernel_id).size / 2 + 1;
+}
 
-    if (m_filter == "prewitt_3") {
-        matrix_x = matrix_x_prewitt_3;
-        matrix_y = matrix_y_prewitt_3;
-        matrix_size = 3;
-    }
-    if (m_filter == "prewitt_5") {
-        matrix_x = matrix_x_prewitt_5;
-        matrix_y = matrix_y_prewitt_5;
-        matrix_size = 5;
-    }
-    if (m_filter == "prewitt_7") {
-        matrix_x = matrix_x_prewitt_7;
-        matrix_y = matrix_y_prewitt_7;
-        matrix_size = 7;
-    }
-    else if (m_filter == "sobel") {
-        matrix_x = matrix_x_sobel;
-        matrix_y = matrix_y_sobel;
-        matrix_size = 3;
-    }
-    else if (m_filter == "tpo_5") {
-        matrix_x = matrix_x_tpo_5;
-        matrix_y = matrix_y_tpo_5;
-        matrix_size = 5;
-    }
-    else if (m_filter == "tpo_7") {
-        matrix_x = matrix_x_tpo_7;
-        matrix_y = matrix_y_tpo_7;
-        matrix_size = 7;
-    }
+ColorGradientField::~ColorGradientField() {}
 
-    // init
-    double min_len = -1, max_len = -1, cur_len = -1;
 
-    double **values_x, **values_y;
-    GradientVector **gf_1;
-    values_x = new double*[image.height()];
-    values_y = new double*[image.height()];
-    gf_1 = new GradientVector*[image.height()];
-    for (int i = 0; i < image.height(); i++) {
-        values_x[i] = new double[image.width()];
-        values_y[i] = new double[image.width()];
-        gf_1[i] = new GradientVector[image.width()];
-    }
 
-    // find gradient
-    ImageAlgorithms::convolving(values_x, image.width(), image.height(), image, matrix_x, matrix_size);
-    ImageAlgorithms::convolving(values_y, image.width(), image.height(), image, matrix_y, matrix_size);
+// MultiScaleEdges
+MultiScaleEdges::MultiScaleEdges(QObject *parent) : ImagePreprocess(parent) {
+    m_filter = "prewitt_3";
+    kernel_id = KernelRegistry::Prewitt3;
+    m_sigma = 1.0;
+    m_levels = 3;
+    m_threshold_low = 15;
+    m_threshold_high = 20;
+    m_hysteresis = true;
 
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            gf_1[j][i].set(values_x[j][i], values_y[j][i]);
-            cur_len = gf_1[j][i].len();
-            if (min_len < 0 || max_len < 0) {
-                min_len = max_len = cur_len;
-            }
-            if (min_len > cur_len) {
-                min_len = cur_len;
-            }
-            if (max_len < cur_len) {
-                max_len = cur_len;
-            }
+    group_name = "Multi-scale edges";
+    generateWidget(QList<QMap<QString, QVariant>>(
+    {
+        {
+            std::pair<QString, QVariant>("name", "filter"),
+            std::pair<QString, QVariant>("field_type", "list"),
+            std::pair<QString, QVariant>("variants", KernelRegistry::gradientKernelNames())
+        },
+        {
+            std::pair<QString, QVariant>("name", "sigma"),
+            std::pair<QString, QVariant>("min", 0),
+            std::pair<QString, QVariant>("max", 20)
+        },
+        {
+            std::pair<QString, QVariant>("name", "levels"),
+            std::pair<QString, QVariant>("min", 1),
+            std::pair<QString, QVariant>("max", 6)
+        },
+        {
+            std::pair<QString, QVariant>("name", "threshold_low"),
+            std::pair<QString, QVariant>("min", 0),
+            std::pair<QString, QVariant>("max", 255)
+        },
+        {
+            std::pair<QString, QVariant>("name", "threshold_high"),
+            std::pair<QString, QVariant>("min", 0),
+            std::pair<QString, QVariant>("max", 255)
+        },
+        {
+            std::pair<QString, QVariant>("name", "hysteresis")
         }
-    }
+    }));
+}
 
-    // colorize
-    double cur_min, cur_max;
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            cur_len = gf_1[j][i].len();
-            if (! m_grayscale) {
-                if (cur_len < (max_len - min_len) * 0.5) {
-                    cur_min = min_len;
-                    cur_max = (max_len - min_len) * 0.5;
-                    result.setPixelColor(i, j, QColor( 0, (cur_len - cur_min) * 255 / (cur_max - cur_min), 255 + (cur_len - cur_min) * -255 / (cur_max - cur_min) ));
-                }
-                else {
-                    cur_min = (max_len - min_len) * 0.5;
-                    cur_max = max_len;
-                    result.setPixelColor(i, j, QColor( (cur_len - cur_min) * 255 / (cur_max - cur_min), 255 + (cur_len - cur_min) * -255 / (cur_max - cur_min), 0 ));
-                }
-                if (m_max_border && (i < matrix_size / 2 + 1 || i >= image.width() - (matrix_size / 2 + 1) || j < matrix_size / 2 + 1 || j >= image.height() - (matrix_size / 2 + 1))) {
-                    result.setPixelColor(i, j, QColor(255, 0, 0));
-                }
-            }
-            else {
-                int val = (cur_len - min_len) * 255 / (max_len - min_len);
-                result.setPixelColor(i, j, QColor(val, val, val));
-                if (m_max_border && (i < matrix_size / 2 + 1 || i >= image.width() - (matrix_size / 2 + 1) || j < matrix_size / 2 + 1 || j >= image.height() - (matrix_size / 2 + 1))) {
-                    result.setPixelColor(i, j, QColor(255, 255, 255));
-                }
+QImage MultiScaleEdges::processImage(const QImage &image) {
+    const GradientKernel &kernel = KernelRegistry::gradientKernel(kernel_id);
+    int width = image.width(), height = image.height();
+    int low = m_threshold_low * kernel.weight_divider, high = m_threshold_high * kernel.weight_divider;
+
+    // image is blurred and converted once, every next level is reduced from previous one
+    QVector<float> plane = ImageAlgorithms::grayPlane(m_sigma > 0 ? ImageAlgorithms::recursiveGaussian(image, m_sigma) : image);
+    int level_width = width, level_height = height;
+
+    // buffers are allocated for finest level and reused by coarser ones
+    QVector<float> values_x(width * height), values_y(width * height);
+    QVector<quint16> magnitude(width * height), suppressed(width * height);
+    QVector<uchar> orientation(width * height), edges(width * height);
+    QVector<uchar> fused(width * height, 0);
+
+    for (int l = 0; l < m_levels && level_width >= kernel.size && level_height >= kernel.size; l++) {
+        int count = level_width * level_height;
+        ImageAlgorithms::convolvePlane(plane.constData(), level_width, level_height, kernel.x.constData(), kernel.size, values_x.data());
+        ImageAlgorithms::convolvePlane(plane.constData(), level_width, level_height, kernel.y.constData(), kernel.size, values_y.data());
+        ImageAlgorithms::gradientPlanes(values_x.constData(), values_y.constData(), count, magnitude.data(), orientation.data());
+        ImageAlgorithms::nonMaximumSuppression(magnitude.constData(), orientation.constData(), level_width, level_height, suppressed.data());
+        ImageAlgorithms::hysteresisThreshold(suppressed.constData(), level_width, level_height, low, high, m_hysteresis, edges.data());
+
+        // coarse edges cover 2^l pixels wide band, following thinning makes them one pixel wide
+        for (int y = 0; y < height; y++) {
+            const uchar *level_line = edges.constData() + std::min(y >> l, level_height - 1) * level_width;
+            uchar *fused_line = fused.data() + y * width;
+            for (int x = 0; x < width; x++) {
+                fused_line[x] = std::max(fused_line[x], level_line[std::min(x >> l, level_width - 1)]);
             }
         }
+
+        plane = ImageAlgorithms::pyramidDown(plane, level_width, level_height);
+        level_width = (level_width + 1) / 2;
+        level_height = (level_height + 1) / 2;
     }
 
-    // destruct
-    for (int i = 0; i < image.height(); i++) {
-        delete [] values_x[i];
-        delete [] values_y[i];
-        delete [] gf_1[i];
+    // monochromize
+    QImage result(width, height, QImage::Format_RGB32);
+    const QRgb colors[3] = {fusedColor(qRgb(0, 0, 0)), fusedColor(qRgb(128, 128, 128)), fusedColor(qRgb(255, 255, 255))};
+    for (int j = 0; j < height; j++) {
+        QRgb *line = reinterpret_cast<QRgb*>(result.scanLine(j));
+        for (int i = 0; i < width; i++) {
+            line[i] = colors[fused[j * width + i]];
+        }
     }
-    delete [] values_x;
-    delete [] values_y;
-    delete [] gf_1;
 
     return result;
 }
 
-ColorGradientField::~ColorGradientField() {}
+void MultiScaleEdges::setFilter(const QString &filter) {
+    m_filter = filter;
+    kernel_id = KernelRegistry::gradientKernelId(filter);
+    emit filterChanged(m_filter);
+}
+
+int MultiScaleEdges::halo() {
+    // kernel, suppression and pyramid blur reach grows twice with every level
+    int level_halo = KernelRegistry::gradientKernel(kernel_id).size / 2 + 2 + 2;
+    return (int)ceil(3 * m_sigma) + (level_halo << (std::max(m_levels, 1) - 1));
+}
+
+MultiScaleEdges::~MultiScaleEdges() {}
 
 
 
@@ -683,15 +540,18 @@ SegmentationField::SegmentationField(QObject *parent) : ImagePreprocess(parent)
 }
 
 QImage SegmentationField::processImage(const QImage &image) {
-    QImage result(image);
+    return processPlane(ImagePlane(image)).toImage();
+}
 
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            int color_val = result.pixelColor(i, j).value();
-            result.setPixelColor(i, j, QColor(color_val));
-            if (result.pixelColor(i, j).value() < m_threshold_low) {
-                result.setPixelColor(i, j, QColor(0, 0, 0));
-            }
+ImagePlane SegmentationField::processPlane(const ImagePlane &image) {
+    int width = image.width();
+
+    // previous stage may already have written values through inputLut
+    QVector<float> value = image.valuePlane();
+    if (! input_fused) {
+        for (int k = 0; k < value.count(); k++) {
+            if (value[k] < m_threshold_low)
+                value[k] = 0;
         }
     }
 
@@ -712,22 +572,22 @@ QImage SegmentationField::processImage(const QImage &image) {
             while (! stack.isEmpty()) {
                 QPoint cur_p = stack.pop();
                 areas_field[cur_p.y()][cur_p.x()] = cur_area;
-                if (cur_p.x() + 1 < image.width() && result.pixelColor(cur_p.x() + 1, cur_p.y()).value() >= result.pixelColor(cur_p.x(), cur_p.y()).value() && areas_field[cur_p.y()][cur_p.x() + 1] == -1) {
+                if (cur_p.x() + 1 < image.width() && value[cur_p.y() * width + cur_p.x() + 1] >= value[cur_p.y() * width + cur_p.x()] && areas_field[cur_p.y()][cur_p.x() + 1] == -1) {
                     QPoint new_p(cur_p.x() + 1, cur_p.y());
                     areas_field[new_p.y()][new_p.x()] = 0;
                     stack.push(new_p);
                 }
-                if (cur_p.x() - 1 >= 0 && result.pixelColor(cur_p.x() - 1, cur_p.y()).value() >= result.pixelColor(cur_p.x(), cur_p.y()).value() && areas_field[cur_p.y()][cur_p.x() - 1] == -1) {
+                if (cur_p.x() - 1 >= 0 && value[cur_p.y() * width + cur_p.x() - 1] >= value[cur_p.y() * width + cur_p.x()] && areas_field[cur_p.y()][cur_p.x() - 1] == -1) {
                     QPoint new_p(cur_p.x() - 1, cur_p.y());
                     areas_field[new_p.y()][new_p.x()] = 0;
                     stack.push(new_p);
                 }
-                if (cur_p.y() + 1 < image.height() && result.pixelColor(cur_p.x(), cur_p.y() + 1).value() >= result.pixelColor(cur_p.x(), cur_p.y()).value() && areas_field[cur_p.y() + 1][cur_p.x()] == -1) {
+                if (cur_p.y() + 1 < image.height() && value[(cur_p.y() + 1) * width + cur_p.x()] >= value[cur_p.y() * width + cur_p.x()] && areas_field[cur_p.y() + 1][cur_p.x()] == -1) {
                     QPoint new_p(cur_p.x(), cur_p.y() + 1);
                     areas_field[new_p.y()][new_p.x()] = 0;
                     stack.push(new_p);
                 }
-                if (cur_p.y() - 1 >= 0 && result.pixelColor(cur_p.x(), cur_p.y() - 1).value() >= result.pixelColor(cur_p.x(), cur_p.y()).value() && areas_field[cur_p.y() - 1][cur_p.x()] == -1) {
+                if (cur_p.y() - 1 >= 0 && value[(cur_p.y() - 1) * width + cur_p.x()] >= value[cur_p.y() * width + cur_p.x()] && areas_field[cur_p.y() - 1][cur_p.x()] == -1) {
                     QPoint new_p(cur_p.x(), cur_p.y() - 1);
                     areas_field[new_p.y()][new_p.x()] = 0;
                     stack.push(new_p);
@@ -739,7 +599,7 @@ QImage SegmentationField::processImage(const QImage &image) {
     // fill areas minimums
     for (int j = 0; j < image.height(); j++) {
         for (int i = 0; i < image.width(); i++) {
-            if (result.pixelColor(i, j).value() == 0 && areas_field[j][i] == -1) {
+            if (value[j * width + i] == 0 && areas_field[j][i] == -1) {
                 fillArea(i, j, cur_area);
                 cur_area++;
             }
@@ -868,22 +728,23 @@ QImage SegmentationField::processImage(const QImage &image) {
         }
     }
 
-    // colorize
-    for (int j = 0; j < image.height(); j++) {
-        for (int i = 0; i < image.width(); i++) {
-            if (areas_field[j][i] > 0) {
-                if (! m_classification) {
-                    QColor area_color = QColor::fromHsvF(1.0 / (double)cur_area * (double)areas_field[j][i], 1.0, 1.0);
-                    result.setPixelColor(i, j, area_color);
-                }
-                else {
-                    if (areas_field[j][i] == 1) {
-                        result.setPixelColor(i, j, QColor(0, 0, 0));
-                    }
-                    else if (areas_field[j][i] == 2) {
-                        result.setPixelColor(i, j, QColor(255, 255, 255));
-                    }
-                }
+    // classified areas form a mask of small areas, otherwise every area keeps own label
+    // unlabelled pixels are cut where ThinningFilter binarizes values
+    ImagePlane result;
+    if (m_classification) {
+        result = ImagePlane::mask(image.width(), image.height());
+        for (int j = 0; j < image.height(); j++) {
+            for (int i = 0; i < image.width(); i++) {
+                result.setMaskBit(i, j, areas_field[j][i] > 0 ? areas_field[j][i] == 2 : value[j * width + i] >= 127);
+            }
+        }
+    }
+    else {
+        result = ImagePlane::labels(image.width(), image.height(), cur_area - 1);
+        quint32 *labels = result.labelData();
+        for (int j = 0; j < image.height(); j++) {
+            for (int i = 0; i < image.width(); i++) {
+                labels[j * width + i] = std::max(areas_field[j][i], 0);
             }
         }
     }
@@ -896,6 +757,19 @@ QImage SegmentationField::processImage(const QImage &image) {
     return result;
 }
 
+uchar SegmentationField::inputLut(uchar value) {
+    return value < m_threshold_low ? 0 : value;
+}
+
+float SegmentationField::inputValue(float value) {
+    return value < m_threshold_low ? 0 : value;
+}
+
+int SegmentationField::halo() {
+    // areas are flooded across the whole image and classified by their size
+    return whole_image_halo;
+}
+
 SegmentationField::~SegmentationField() {}
 
 
@@ -906,7 +780,14 @@ ThinningFilter::ThinningFilter(QObject *parent) : ImagePreprocess(parent) {
 }
 
 QImage ThinningFilter::processImage(const QImage &image) {
-    QImage result(image);
+    return processPlane(ImagePlane(image)).toImage();
+}
+
+ImagePlane ThinningFilter::processPlane(const ImagePlane &image) {
+    // masks are read directly, other planes are binarized by value
+    QVector<float> value;
+    if (image.type() != ImagePlane::Mask)
+        value = image.valuePlane();
 
     int **res = new int*[image.height()];
     int **buf = new int*[image.height()];
@@ -917,7 +798,7 @@ QImage ThinningFilter::processImage(const QImage &image) {
 
     for (int j = 0; j < image.height(); j++) {
         for (int i = 0; i < image.width(); i++) {
-            buf[j][i] = image.pixelColor(i, j).value() < 127 ? 0 : 1;
+            buf[j][i] = image.type() == ImagePlane::Mask ? image.maskBit(i, j) : (value[j * image.width() + i] < 127 ? 0 : 1);
             if (i == 0 || j == 0 || i == image.width() - 1 || j == image.height() - 1) buf[j][i] = 0;
         }
     }
@@ -967,9 +848,10 @@ QImage ThinningFilter::processImage(const QImage &image) {
         copyBuf();
     }
 
+    ImagePlane result = ImagePlane::mask(image.width(), image.height());
     for (int j = 0; j < image.height(); j++) {
         for (int i = 0; i < image.width(); i++) {
-            result.setPixelColor(i, j, QColor(res[j][i] ? 255 : 0, res[j][i] ? 255 : 0, res[j][i] ? 255 : 0));
+            result.setMaskBit(i, j, res[j][i]);
         }
     }
 
@@ -983,10 +865,97 @@ QImage ThinningFilter::processImage(const QImage &image) {
     return result;
 }
 
+int ThinningFilter::halo() {
+    // passes repeat until nothing changes, so a line is thinned by its pixels far outside region
+    return whole_image_halo;
+}
+
 ThinningFilter::~ThinningFilter() {}
 
 
 
+// PerspectiveCorrection
+PerspectiveCorrection::PerspectiveCorrection(QObject *parent) : ImagePreprocess(parent) {
+    m_reference_points = "";
+    m_max_skew = 5;
+
+    group_name = "Perspective correction";
+    generateWidget(QList<QMap<QString, QVariant>>(
+    {
+        {
+            std::pair<QString, QVariant>("name", "reference_points"),
+            std::pair<QString, QVariant>("field_type", "text")
+        },
+        {
+            std::pair<QString, QVariant>("name", "max_skew"),
+            std::pair<QString, QVariant>("min", 0),
+            std::pair<QString, QVariant>("max", 45)
+        }
+    }));
+}
+
+bool PerspectiveCorrection::pointsTransform(QTransform &transform) {
+    QPolygonF quad;
+    for (const QString &point : m_reference_points.split(";", Qt::SkipEmptyParts)) {
+        QStringList coords = point.split(",");
+        bool ok_x = false, ok_y = false;
+        if (coords.count() == 2)
+            quad.append(QPointF(coords[0].trimmed().toDouble(&ok_x), coords[1].trimmed().toDouble(&ok_y)));
+        if (! ok_x || ! ok_y)
+            return false;
+    }
+    if (quad.count() != 4)
+        return false;
+
+    // corners ordered by angle around center: top left, top right, bottom right, bottom left
+    QPointF center = (quad[0] + quad[1] + quad[2] + quad[3]) / 4;
+    std::sort(quad.begin(), quad.end(), [&](const QPointF &a, const QPointF &b) {
+        return atan2(a.y() - center.y(), a.x() - center.x()) < atan2(b.y() - center.y(), b.x() - center.x());
+    });
+
+    // target rectangle keeps mean side lengths around the same center
+    double width = (QLineF(quad[0], quad[1]).length() + QLineF(quad[3], quad[2]).length()) / 2;
+    double height = (QLineF(quad[0], quad[3]).length() + QLineF(quad[1], quad[2]).length()) / 2;
+    QPolygonF rect(QRectF(center.x() - width / 2, center.y() - height / 2, width, height));
+    rect.removeLast(); // closing point
+    return QTransform::quadToQuad(rect, quad, transform);
+}
+
+bool PerspectiveCorrection::gridTransform(const QImage &image, QTransform &transform) {
+    AxisEstimate estimate = AxisDetector::detect(image, m_max_skew);
+    if (! estimate.x_axis_found && ! estimate.y_axis_found)
+        return false;
+
+    // family which was not found is taken perpendicular to the other one
+    double row_angle = estimate.x_axis_found ? estimate.row_angle : estimate.column_angle;
+    double column_angle = estimate.y_axis_found ? estimate.column_angle : estimate.row_angle;
+    if (row_angle == 0 && column_angle == 0)
+        return false;
+
+    // rectified rows and columns follow found lines, image center stays in place
+    double hx = cos(row_angle), hy = sin(row_angle), vx = -sin(column_angle), vy = cos(column_angle);
+    double cx = image.width() / 2.0, cy = image.height() / 2.0;
+    transform = QTransform(hx, hy, vx, vy, cx - hx * cx - vx * cy, cy - hy * cx - vy * cy);
+    return true;
+}
+
+QImage PerspectiveCorrection::processImage(const QImage &image) {
+    QTransform transform;
+    bool has_points = ! m_reference_points.trimmed().isEmpty();
+    if (has_points ? ! pointsTransform(transform) : ! gridTransform(image, transform))
+        return image;
+    return ImageAlgorithms::warpPerspective(image, transform, qRgb(255, 255, 255));
+}
+
+int PerspectiveCorrection::halo() {
+    // any input pixel may land in region
+    return whole_image_halo;
+}
+
+PerspectiveCorrection::~PerspectiveCorrection() {}
+
+
+
 // ImageProcessor
 ImageProcessor::ImageProcessor(QWidget *prop_group_widget, QObject *parent) : QObject(parent) {
     this->prop_group_widget = prop_group_widget;
@@ -1018,15 +987,59 @@ void ImageProcessor::clear() {
     }
 }
 
+int ImageProcessor::halo() {
+    // halos of consecutive filters add up
+    int result = 0;
+    for (int i = 0; i < middleware.count(); i++) {
+        if (middleware[i]->isUse())
+            result += middleware[i]->halo();
+    }
+    return result;
+}
+
+QByteArray ImageProcessor::chainSignature() {
+    QByteArray signature;
+    for (int i = 0; i < middleware.count(); i++) {
+        signature += ResultCache::stageSignature(middleware[i], middleware[i]->isUse());
+    }
+    return signature;
+}
+
+void ImageProcessor::planFusion() {
+    ImagePreprocess *prev = nullptr;
+    for (int i = 0; i < middleware.count(); i++) {
+        middleware[i]->setFusedLut(QVector<uchar>(), nullptr);
+        middleware[i]->setInputFused(false);
+        if (! middleware[i]->isUse())
+            continue;
+        // output of previous stage is only read by this one, so it may be written already mapped
+        if (prev != nullptr && prev->hasOutputLut() && middleware[i]->hasInputLut()) {
+            QVector<uchar> lut(256);
+            for (int v = 0; v < 256; v++) {
+                lut[v] = middleware[i]->inputLut(v);
+            }
+            prev->setFusedLut(lut, middleware[i]);
+            middleware[i]->setInputFused(true);
+        }
+        prev = middleware[i];
+    }
+}
+
 // slots
-void ImageProcessor::processImage(const QImage &image) {
+void ImageProcessor::processImage(const QImage &image, const QRect &roi) {
     emit startCalculating(middleware.count(), "Processing image...");
-    QImage result(image);
+    planFusion();
+    // stages exchange typed planes, image is built once for display
+    ImagePlane plane(image);
     for (int i = 0; i < middleware.count(); i++) {
         emit currentFilter(i, middleware[i]->getGroupName());
         if (! middleware[i]->isUse())
             continue;
-        result = middleware[i]->processImage(result);
+        plane = middleware[i]->processPlane(plane);
+    }
+    QImage result = plane.toImage();
+    if (! roi.isNull() && roi != result.rect()) {
+        result = result.copy(roi);
     }
     emit finishCalculating();
     emit resultReady(result);
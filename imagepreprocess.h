@@ -26,6 +26,7 @@
 #include <QMap>
 #include <QVariant>
 #include <QImage>
+#include <QtConcurrent>
 
 #include <QDebug>
 
@@ -33,6 +34,9 @@
 
 #include "formgenerator.h"
 #include "algorithms.h"
+#include "kernels.h"
+#include "imageplane.h"
+#include "axisdetector.h"
 
 class ImagePreprocess : public FormGenerator {
     Q_OBJECT;
@@ -42,6 +46,14 @@ protected:
     QString group_name;
     bool use;
 
+    // fusion with neighbour stages, set by ImageProcessor before every run
+    QVector<uchar> fused_lut; // input lut of next stage, applied to output colors; empty when not fused
+    ImagePreprocess *fused_next; // stage which input lut is fused, value planes call its inputValue
+    bool input_fused; // input already went through own inputLut in previous stage
+    QRgb fusedColor(QRgb color);
+    // value plane counterpart, goes through inputValue of next stage
+    float fusedValue(float value);
+
     // use generateWidget in constructor of extended class
     // it may generate interface widget for this image processor using its meta properties
     void generateWidget(const QList<QMap<QString, QVariant>> &widget_properties);
@@ -53,6 +65,21 @@ public:
     QWidget* getWidget() { return interface_widget; }
 
     virtual QImage processImage(const QImage &image) = 0;
+    // stages with typed output override it, default one goes through processImage
+    virtual ImagePlane processPlane(const ImagePlane &plane);
+    // pixels around region of interest which affect result inside it
+    virtual int halo() { return 0; }
+    // halo of stages which read the whole image, region is then decoded in full and only cropped
+    static const int whole_image_halo = 1 << 20;
+    // stage writes output colors through lookup table, so input lut of next stage can be folded in
+    virtual bool hasOutputLut() { return false; }
+    // stage starts with pointwise map of pixel value (max of rgb), which previous stage may do instead
+    virtual bool hasInputLut() { return false; }
+    virtual uchar inputLut(uchar value) { return value; }
+    // the same map for unquantized values of Value planes
+    virtual float inputValue(float value) { return inputLut(std::min(255, std::max(0, (int)value))); }
+    void setFusedLut(const QVector<uchar> &fused_lut, ImagePreprocess *fused_next) { this->fused_lut = fused_lut; this->fused_next = fused_next; }
+    void setInputFused(bool input_fused) { this->input_fused = input_fused; }
     virtual ~ImagePreprocess();
 
 public slots:
@@ -77,6 +104,8 @@ public:
     explicit MonochromeGradientImage(QObject *parent = nullptr);
 
     virtual QImage processImage(const QImage &image);
+    virtual int halo();
+    virtual bool hasOutputLut() { return true; }
     virtual ~MonochromeGradientImage();
 
 signals:
@@ -89,25 +118,29 @@ class GaussianBlur : public ImagePreprocess {
     Q_OBJECT;
     Q_PROPERTY(double sigma MEMBER m_sigma NOTIFY sigmaChanged);
     Q_PROPERTY(int size MEMBER m_size NOTIFY sizeChanged);
+    Q_PROPERTY(QString method MEMBER m_method NOTIFY methodChanged);
 
 private:
     double m_sigma;
     int m_size;
+    QString m_method; // direct - size x size kernel, recursive - IIR filter, box - three box blurs; last two ignore size
 
 public:
     explicit GaussianBlur(QObject *parent = nullptr);
 
     virtual QImage processImage(const QImage &image);
+    virtual int halo();
     virtual ~GaussianBlur();
 
 signals:
     void sigmaChanged(double);
     void sizeChanged(int);
+    void methodChanged(QString);
 };
 
 class CannyFilter : public ImagePreprocess {
     Q_OBJECT;
-    Q_PROPERTY(QString filter MEMBER m_filter NOTIFY filterChanged);
+    Q_PROPERTY(QString filter MEMBER m_filter WRITE setFilter NOTIFY filterChanged);
     Q_PROPERTY(bool supression MEMBER m_supression NOTIFY supressionChanged);
     Q_PROPERTY(int threshold_low MEMBER m_threshold_low NOTIFY thresholdLowChanged);
     Q_PROPERTY(int threshold_high MEMBER m_threshold_high NOTIFY thresholdHighChanged);
@@ -115,6 +148,7 @@ class CannyFilter : public ImagePreprocess {
 
 private:
     QString m_filter;
+    KernelRegistry::GradientKernelId kernel_id; // resolved from m_filter when it is set
     bool m_supression;
     int m_threshold_low;
     int m_threshold_high;
@@ -123,7 +157,11 @@ private:
 public:
     explicit CannyFilter(QObject *parent = nullptr);
 
+    void setFilter(const QString &filter);
+
     virtual QImage processImage(const QImage &image);
+    virtual int halo();
+    virtual bool hasOutputLut() { return true; }
     virtual ~CannyFilter();
 
 signals:
@@ -136,19 +174,26 @@ signals:
 
 class ColorGradientField : public ImagePreprocess {
     Q_OBJECT;
-    Q_PROPERTY(QString filter MEMBER m_filter NOTIFY filterChanged);
+    Q_PROPERTY(QString filter MEMBER m_filter WRITE setFilter NOTIFY filterChanged);
     Q_PROPERTY(bool max_border MEMBER m_max_border NOTIFY maxBorderChanged);
     Q_PROPERTY(bool grayscale MEMBER m_grayscale NOTIFY grayscaleChanged);
 
 private:
     QString m_filter;
+    KernelRegistry::GradientKernelId kernel_id; // resolved from m_filter when it is set
     bool m_max_border;
     bool m_grayscale;
 
 public:
     explicit ColorGradientField(QObject *parent = nullptr);
 
+    void setFilter(const QString &filter);
+
     virtual QImage processImage(const QImage &image);
+    // result is Value plane of gradient length, colors are its palette
+    virtual ImagePlane processPlane(const ImagePlane &source);
+    virtual int halo();
+    virtual bool hasOutputLut() { return true; }
     virtual ~ColorGradientField();
 
 signals:
@@ -157,6 +202,45 @@ signals:
     void grayscaleChanged(bool);
 };
 
+// canny edges found on every level of gaussian pyramid and fused into one map,
+// thin lines respond on fine levels and thick curves on coarse ones
+class MultiScaleEdges : public ImagePreprocess {
+    Q_OBJECT;
+    Q_PROPERTY(QString filter MEMBER m_filter WRITE setFilter NOTIFY filterChanged);
+    Q_PROPERTY(double sigma MEMBER m_sigma NOTIFY sigmaChanged);
+    Q_PROPERTY(int levels MEMBER m_levels NOTIFY levelsChanged);
+    Q_PROPERTY(int threshold_low MEMBER m_threshold_low NOTIFY thresholdLowChanged);
+    Q_PROPERTY(int threshold_high MEMBER m_threshold_high NOTIFY thresholdHighChanged);
+    Q_PROPERTY(bool hysteresis MEMBER m_hysteresis NOTIFY hysteresisChanged);
+
+private:
+    QString m_filter;
+    KernelRegistry::GradientKernelId kernel_id;
+    double m_sigma; // blur of finest level
+    int m_levels;
+    int m_threshold_low;
+    int m_threshold_high;
+    bool m_hysteresis;
+
+public:
+    explicit MultiScaleEdges(QObject *parent = nullptr);
+
+    void setFilter(const QString &filter);
+
+    virtual QImage processImage(const QImage &image);
+    virtual int halo();
+    virtual bool hasOutputLut() { return true; }
+    virtual ~MultiScaleEdges();
+
+signals:
+    void filterChanged(QString);
+    void sigmaChanged(double);
+    void levelsChanged(int);
+    void thresholdLowChanged(int);
+    void thresholdHighChanged(int);
+    void hysteresisChanged(bool);
+};
+
 class SegmentationField : public ImagePreprocess {
     Q_OBJECT;
     Q_PROPERTY(int threshold_low MEMBER m_threshold_low NOTIFY thresholdLowChanged);
@@ -174,6 +258,12 @@ public:
     explicit SegmentationField(QObject *parent = nullptr);
 
     virtual QImage processImage(const QImage &image);
+    // result is Mask of small areas with classification, Labels of areas without it
+    virtual ImagePlane processPlane(const ImagePlane &image);
+    virtual bool hasInputLut() { return true; }
+    virtual uchar inputLut(uchar value);
+    virtual float inputValue(float value);
+    virtual int halo();
     virtual ~SegmentationField();
 
 signals:
@@ -194,11 +284,41 @@ public:
     explicit ThinningFilter(QObject *parent = nullptr);
 
     virtual QImage processImage(const QImage &image);
+    virtual ImagePlane processPlane(const ImagePlane &image);
+    virtual int halo();
     virtual ~ThinningFilter();
 
 signals:
 };
 
+// rectifies rotated and perspective distorted photos, output keeps input size
+// with four reference points "x,y;x,y;x,y;x,y" (corners of a rectangle on plot, any order) homography maps them to a rectangle
+// without them skew of grid lines found by Hough transform is removed by affine warp
+class PerspectiveCorrection : public ImagePreprocess {
+    Q_OBJECT;
+    Q_PROPERTY(QString reference_points MEMBER m_reference_points NOTIFY referencePointsChanged);
+    Q_PROPERTY(double max_skew MEMBER m_max_skew NOTIFY maxSkewChanged);
+
+private:
+    QString m_reference_points;
+    double m_max_skew; // degrees, range of grid line search
+
+    // mapping from rectified pixels to input pixels, false when nothing is to be corrected
+    bool pointsTransform(QTransform &transform);
+    bool gridTransform(const QImage &image, QTransform &transform);
+
+public:
+    explicit PerspectiveCorrection(QObject *parent = nullptr);
+
+    virtual QImage processImage(const QImage &image);
+    virtual int halo();
+    virtual ~PerspectiveCorrection();
+
+signals:
+    void referencePointsChanged(QString);
+    void maxSkewChanged(double);
+};
+
 // image processors implementations end
 
 class ImageProcessor : public QObject {
@@ -213,15 +333,21 @@ public:
 
     void addMiddleware(ImagePreprocess* mid_elem);
     void clear();
+    int halo();
+    // folds pointwise input of every stage into output lut of previous one
+    void planFusion();
+    // stages with their settings, result cache key part
+    QByteArray chainSignature();
 
 public slots:
-    void processImage(const QImage &image);
+    // image is region of interest with halo around it, only roi part of result is returned
+    void processImage(const QImage &image, const QRect &roi);
     void moveUpPreprocess();
     void moveDownPreprocess();
     void deletePreprocess();
 
 signals:
-    void resultReady(const QImage &);
+    void resultReady(const QImage &); // image data is shared, queued delivery does not copy pixels
     void startCalculating(int, QString); // count of filters
     void currentFilter(int, QString); // number, name
     void finishCalculating();
@@ -4,9 +4,12 @@ ImageView::ImageView(QWidget *parent) : QGraphicsView(parent) {
     this->points_visible = true;
 
     this->bg_image = nullptr;
+    this->processed_bg_image = nullptr;
+    this->region_item = nullptr;
     this->x_axis = nullptr;
     this->y_axis = nullptr;
 
+    this->cursor_mode = ImageViewCursorMode::Arrow;
     this->scale_factor = 1;
     this->pps_x = this->pps_y = 50;
 
@@ -26,14 +29,31 @@ ImageView::~ImageView() {
     this->deleteSceneItems();
 }
 
-void ImageView::initSceneItems(const QPixmap &pixmap) {
-    this->opened_pixmap = pixmap;
+void ImageView::initSceneItems(const QImage &image, const QSize &source_size) {
     this->show_processed_image_state = false;
+    this->source_size = source_size.isValid() ? source_size : image.size();
 
     this->deleteSceneItems();
 
-    this->bg_image = this->scene->addPixmap(opened_pixmap);
-    this->scene->setSceneRect(opened_pixmap.rect());
+    // opened and processed images keep own tile caches, so switching between them is instant
+    this->bg_image = new TiledImageItem();
+    this->bg_image->setImage(image);
+    this->fitToSource(this->bg_image);
+    this->scene->addItem(this->bg_image);
+
+    this->processed_bg_image = new TiledImageItem();
+    this->processed_bg_image->setVisible(false);
+    this->scene->addItem(this->processed_bg_image);
+
+    this->region_item = new QGraphicsRectItem();
+    QPen region_pen(QColor(50, 120, 240), 2, Qt::DashLine);
+    region_pen.setCosmetic(true);
+    this->region_item->setPen(region_pen);
+    this->region_item->setVisible(false);
+    this->scene->addItem(this->region_item);
+    this->selected_region = QRect();
+
+    this->scene->setSceneRect(QRectF(QPointF(0, 0), QSizeF(this->source_size)));
 
     QRectF scene_rect = this->scene->sceneRect();
 
@@ -57,9 +77,25 @@ void ImageView::initSceneItems(const QPixmap &pixmap) {
     this->resizeContent();
 }
 
-void ImageView::setProcessedImage(const QPixmap &processed_pixmap) {
-    this->processed_pixmap = processed_pixmap;
-    this->bg_image->setPixmap(show_processed_image_state ? processed_pixmap : opened_pixmap);
+void ImageView::fitToSource(TiledImageItem *item) {
+    QSize image_size = item->getImage().size();
+    if (! image_size.isEmpty()) {
+        item->setTransform(QTransform::fromScale((double)source_size.width() / image_size.width(), (double)source_size.height() / image_size.height()));
+    }
+}
+
+void ImageView::setOpenedImage(const QImage &image) {
+    if (this->bg_image != nullptr) {
+        // image shown so far stays as preview, so first paint of full image needs no full resolution pass
+        this->bg_image->setImage(image, this->bg_image->getImage());
+        this->fitToSource(this->bg_image);
+    }
+}
+
+void ImageView::setProcessedImage(const QImage &processed_image, const QPoint &offset) {
+    this->processed_bg_image->setImage(processed_image);
+    this->processed_bg_image->setPos(offset);
+    this->showProcessedImage(show_processed_image_state);
 }
 
 void ImageView::deleteSceneItems() {
@@ -72,10 +108,32 @@ void ImageView::deleteSceneItems() {
     this->points.clear();
 
     this->bg_image = nullptr;
+    this->processed_bg_image = nullptr;
+    this->region_item = nullptr;
     this->x_axis = nullptr;
     this->y_axis = nullptr;
 }
 
+void ImageView::clearSelectedRegion() {
+    this->selected_region = QRect();
+    if (this->region_item != nullptr)
+        this->region_item->setVisible(false);
+}
+
+QRect ImageView::getAxesRegion() {
+    // y axis goes up from origin, so plot area lies above start row
+    QRect axes_region(QPoint(start_pixel_x, 0), QPoint(source_size.width() - 1, start_pixel_y));
+    return axes_region.intersected(QRect(QPoint(0, 0), source_size));
+}
+
+QVector<QPointF> ImageView::getPointPositions() {
+    QVector<QPointF> positions;
+    for (int i = 0; i < points.count(); i++) {
+        positions.append(points[i]->pos());
+    }
+    return positions;
+}
+
 void ImageView::resizeContent() {
     QRectF scene_rect = this->scene->sceneRect();
 
@@ -110,12 +168,42 @@ void ImageView::mousePressEvent(QMouseEvent *event) {
         this->scene->addItem(point);
         points.push_back(point);
     }
+    else if (cursor_mode == ImageViewCursorMode::SelectRegion && this->region_item != nullptr) {
+        region_start = mapToScene(event->pos());
+        this->region_item->setRect(QRectF(region_start, region_start));
+        this->region_item->setVisible(true);
+    }
     else {
         QGraphicsView::mousePressEvent(event);
     }
 
 }
 
+void ImageView::mouseMoveEvent(QMouseEvent *event) {
+    if (cursor_mode == ImageViewCursorMode::SelectRegion && this->region_item != nullptr && (event->buttons() & Qt::LeftButton)) {
+        this->region_item->setRect(QRectF(region_start, mapToScene(event->pos())).normalized());
+    }
+    else {
+        QGraphicsView::mouseMoveEvent(event);
+    }
+}
+
+void ImageView::mouseReleaseEvent(QMouseEvent *event) {
+    if (cursor_mode == ImageViewCursorMode::SelectRegion && this->region_item != nullptr) {
+        // click without dragging clears selection
+        QRect region = this->region_item->rect().toAlignedRect().intersected(this->scene->sceneRect().toAlignedRect());
+        if (region.width() < 2 || region.height() < 2) {
+            region = QRect();
+            this->region_item->setVisible(false);
+        }
+        this->selected_region = region;
+        emit regionSelected(region);
+    }
+    else {
+        QGraphicsView::mouseReleaseEvent(event);
+    }
+}
+
 // slots
 
 void ImageView::setCursorMode(ImageViewCursorMode cursor_mode) {
@@ -129,6 +217,10 @@ void ImageView::setCursorMode(ImageViewCursorMode cursor_mode) {
         case (ImageViewCursorMode::Arrow):
             setCursor(QCursor(Qt::ArrowCursor));
             break;
+
+        case (ImageViewCursorMode::SelectRegion):
+            setCursor(QCursor(Qt::CrossCursor));
+            break;
     }
 }
 
@@ -158,7 +250,10 @@ void ImageView::imagePointsVisible(int state) {
 
 void ImageView::showProcessedImage(int state) {
     this->show_processed_image_state = state;
-    this->bg_image->setPixmap(state ? processed_pixmap : opened_pixmap);
+    if (this->bg_image != nullptr && this->processed_bg_image != nullptr) {
+        this->bg_image->setVisible(! state);
+        this->processed_bg_image->setVisible(state);
+    }
 }
 
 void ImageView::setStartPixelX(int start_pixel) {
@@ -184,3 +279,12 @@ void ImageView::setStepX(double step) {
 void ImageView::setStepY(double step) {
     this->step_y = step;
 }
+
+void ImageView::setAxesOrigin(int start_pixel_x, int start_pixel_y) {
+    this->start_pixel_x = start_pixel_x;
+    this->start_pixel_y = start_pixel_y;
+    if (this->x_axis != nullptr)
+        this->x_axis->setPos(0, start_pixel_y - 5);
+    if (this->y_axis != nullptr)
+        this->y_axis->setPos(start_pixel_x - 5, 0);
+}
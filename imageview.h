@@ -6,15 +6,17 @@
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QGraphicsItemGroup>
+#include <QGraphicsRectItem>
 #include <QObject>
 #include <QDebug>
 
 #include "imageaxis.h"
 #include "imagepoint.h"
+#include "tiledimageitem.h"
 
 #define SCALE_FACTOR(scale_factor) (1 + (scale_factor - 1) * 0.5)
 
-enum ImageViewCursorMode {Arrow, AddPoint};
+enum ImageViewCursorMode {Arrow, AddPoint, SelectRegion};
 
 class ImageView : public QGraphicsView {
     Q_OBJECT
@@ -23,26 +25,37 @@ public:
     explicit ImageView(QWidget *parent = 0);
     ~ImageView();
 
-    void initSceneItems(const QPixmap &pixmap);
-    void setProcessedImage(const QPixmap &processed_pixmap);
+    // image may be a reduced preview of image with source_size, it is stretched over source pixels
+    void initSceneItems(const QImage &image, const QSize &source_size = QSize());
+    void setOpenedImage(const QImage &image);
+    void setProcessedImage(const QImage &processed_image, const QPoint &offset = QPoint());
 
     void deleteSceneItems();
     void resizeContent();
 
+    QRect getSelectedRegion() { return selected_region; }
+    void clearSelectedRegion();
+    // positions of placed image points in source pixels
+    QVector<QPointF> getPointPositions();
+    // first quadrant of axes inside source image
+    QRect getAxesRegion();
     int getStartPixelX() { return start_pixel_x; }
     int getStartPixelY() { return start_pixel_y; }
     int getPPSX() { return pps_x; }
     int getPPSY() { return pps_y; }
-    int getStepX() { return step_x; }
-    int getStepY() { return step_y; }
+    double getStepX() { return step_x; }
+    double getStepY() { return step_y; }
 
 private:
     QGraphicsScene *scene;
-    QGraphicsPixmapItem *bg_image;
+    TiledImageItem *bg_image, *processed_bg_image;
     ImageAxis *x_axis, *y_axis;
     QVector<ImagePoint*> points;
     bool points_visible;
-    QPixmap opened_pixmap, processed_pixmap;
+    QGraphicsRectItem *region_item;
+    QPointF region_start;
+    QRect selected_region;
+    QSize source_size;
 
     // custom cursors
     QCursor add_point_cursor;
@@ -56,6 +69,9 @@ private:
 
     void resizeEvent(QResizeEvent *event);
     void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void fitToSource(TiledImageItem *item);
 
 public slots:
     void setCursorMode(ImageViewCursorMode mode);
@@ -71,6 +87,11 @@ public slots:
     void setPPSY(int pps);
     void setStepX(double step);
     void setStepY(double step);
+    // moves axes items to origin in source pixels
+    void setAxesOrigin(int start_pixel_x, int start_pixel_y);
+
+signals:
+    void regionSelected(const QRect &);
 };
 
 #endif // IMAGEVIEW_H
@@ -0,0 +1,130 @@
+#include "kernels.h"
+
+static QVector<GradientKernel> buildGradientKernels() {
+    QVector<GradientKernel> kernels;
+
+    kernels.append({3, 3, {
+        -1, 0, 1,
+        -1, 0, 1,
+        -1, 0, 1
+    }, {
+        -1, -1, -1,
+         0,  0,  0,
+         1,  1,  1
+    }});
+
+    kernels.append({5, 10, {
+        -1, -1, 0, 1, 1,
+        -1, -1, 0, 1, 1,
+        -1, -1, 0, 1, 1,
+        -1, -1, 0, 1, 1,
+        -1, -1, 0, 1, 1
+    }, {
+        -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1,
+         0,  0,  0,  0,  0,
+         1,  1,  1,  1,  1,
+         1,  1,  1,  1,  1
+    }});
+
+    kernels.append({7, 21, {
+        -1, -1, -1, 0, 1, 1, 1,
+        -1, -1, -1, 0, 1, 1, 1,
+        -1, -1, -1, 0, 1, 1, 1,
+        -1, -1, -1, 0, 1, 1, 1,
+        -1, -1, -1, 0, 1, 1, 1,
+        -1, -1, -1, 0, 1, 1, 1,
+        -1, -1, -1, 0, 1, 1, 1
+    }, {
+        -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1,
+         0,  0,  0,  0,  0,  0,  0,
+         1,  1,  1,  1,  1,  1,  1,
+         1,  1,  1,  1,  1,  1,  1,
+         1,  1,  1,  1,  1,  1,  1
+    }});
+
+    kernels.append({3, 4, {
+        -1, 0, 1,
+        -2, 0, 2,
+        -1, 0, 1
+    }, {
+        -1, -2, -1,
+         0,  0,  0,
+         1,  2,  1
+    }});
+
+    kernels.append({5, 15, {
+        -1, -1, 0, 1, 1,
+        -1, -2, 0, 2, 1,
+        -1, -3, 0, 3, 1,
+        -1, -2, 0, 2, 1,
+        -1, -1, 0, 1, 1
+    }, {
+        -1, -1, -1, -1, -1,
+        -1, -2, -3, -2, -1,
+         0,  0,  0,  0,  0,
+         1,  2,  3,  2,  1,
+         1,  1,  1,  1,  1
+    }});
+
+    kernels.append({7, 34, {
+        -1, -1, -1, 0, 1, 1, 1,
+        -1, -2, -2, 0, 2, 2, 1,
+        -1, -2, -3, 0, 3, 2, 1,
+        -1, -2, -3, 0, 3, 2, 1,
+        -1, -2, -3, 0, 3, 2, 1,
+        -1, -2, -2, 0, 2, 2, 1,
+        -1, -1, -1, 0, 1, 1, 1
+    }, {
+        -1, -1, -1, -1, -1, -1, -1,
+        -1, -2, -2, -2, -2, -2, -1,
+        -1, -2, -3, -3, -3, -2, -1,
+         0,  0,  0,  0,  0,  0,  0,
+         1,  2,  3,  3,  3,  2,  1,
+         1,  2,  2,  2,  2,  2,  1,
+         1,  1,  1,  1,  1,  1,  1
+    }});
+
+    return kernels;
+}
+
+QStringList KernelRegistry::gradientKernelNames() {
+    // order matches GradientKernelId
+    return QStringList({"prewitt_3", "prewitt_5", "prewitt_7", "sobel", "tpo_5", "tpo_7"});
+}
+
+KernelRegistry::GradientKernelId KernelRegistry::gradientKernelId(const QString &name) {
+    int id = gradientKernelNames().indexOf(name);
+    return id < 0 ? Prewitt3 : (GradientKernelId)id;
+}
+
+const GradientKernel& KernelRegistry::gradientKernel(GradientKernelId id) {
+    // static initialization is thread safe
+    static const QVector<GradientKernel> kernels = buildGradientKernels();
+    return kernels[id];
+}
+
+QVector<double> KernelRegistry::gaussianKernel(double sigma, int size) {
+    static QMutex mutex;
+    static QHash<QPair<double, int>, QVector<double>> cache;
+
+    QMutexLocker locker(&mutex);
+    QPair<double, int> key(sigma, size);
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return it.value();
+
+    QVector<double> kernel(size * size);
+    for (int j = 0; j < size; j++) {
+        for (int i = 0; i < size; i++) {
+            kernel[j * size + i] = MathFunctions::gaussian2d(i - size / 2, j - size / 2, sigma);
+        }
+    }
+    // parameters come from spin boxes, so only few sets are ever used
+    if (cache.count() >= 64)
+        cache.clear();
+    cache.insert(key, kernel);
+    return kernel;
+}
@@ -0,0 +1,33 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+
+#include "algorithms.h"
+
+// pair of derivative kernels, response is divided by weight_divider to get color units
+struct GradientKernel {
+    int size;
+    int weight_divider;
+    QVector<double> x, y; // size x size, row by row
+};
+
+// kernels are built once and shared by all filters, functions are safe to call from worker threads
+namespace KernelRegistry {
+    enum GradientKernelId {Prewitt3, Prewitt5, Prewitt7, Sobel, Tpo5, Tpo7};
+
+    QStringList gradientKernelNames();
+    // unknown names map to Prewitt3
+    GradientKernelId gradientKernelId(const QString &name);
+    const GradientKernel& gradientKernel(GradientKernelId id);
+
+    // sampled 2d gaussian, size x size row by row
+    QVector<double> gaussianKernel(double sigma, int size);
+}
+
+#endif // KERNELS_H
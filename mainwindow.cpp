@@ -18,11 +18,40 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     graph_cursor_action_group->setExclusive(true);
     graph_cursor_action_group->addAction(ui->actionCursor);
     graph_cursor_action_group->addAction(ui->actionAddPoint);
+    select_region_action = new QAction("Region", this);
+    select_region_action->setCheckable(true);
+    select_region_action->setToolTip("Select image region to process");
+    graph_cursor_action_group->addAction(select_region_action);
     ui->actionCursor->setChecked(true);
     ui->toolBar->addActions(graph_cursor_action_group->actions());
 
     // initialize chart view
     ui->graphicsViewGraph->setRubberBand(QChartView::RectangleRubberBand);
+    connect(&chart_watcher, &QFutureWatcher<ChartContours>::finished, this, &MainWindow::onChartPrepared);
+
+    // image loading
+    opened_preview_shown = false;
+    connect(&preview_watcher, &QFutureWatcher<QImage>::finished, this, &MainWindow::onPreviewLoaded);
+    connect(&full_watcher, &QFutureWatcher<QImage>::finished, this, &MainWindow::onFullImageLoaded);
+    connect(&region_watcher, &QFutureWatcher<QImage>::finished, this, &MainWindow::onRegionLoaded);
+
+    // result cache
+    connect(&hash_watcher, &QFutureWatcher<QByteArray>::finished, this, &MainWindow::onFileHashed);
+    connect(&cache_watcher, &QFutureWatcher<QImage>::finished, this, &MainWindow::onCachedImageLoaded);
+    connect(&product_watcher, &QFutureWatcher<VectorizationResult>::finished, this, &MainWindow::onCachedProductLoaded);
+    image_running = false;
+    graph_running = false;
+    QAction *clear_cache_action = new QAction("Clear result cache", this);
+    connect(clear_cache_action, &QAction::triggered, this, [=]() {
+        QThreadPool::globalInstance()->start([]() { ResultCache::clear(); });
+    });
+    ui->menuTools->addAction(clear_cache_action);
+
+    // axes detection
+    connect(&axes_watcher, &QFutureWatcher<AxisEstimate>::finished, this, &MainWindow::onAxesDetected);
+    QAction *detect_axes_action = new QAction("Detect axes", this);
+    connect(detect_axes_action, &QAction::triggered, this, &MainWindow::onDetectAxes);
+    ui->menuTools->addAction(detect_axes_action);
 
     // connect signal-slots
     QObject::connect(ui->actionOpen, SIGNAL(triggered()), this, SLOT(onOpenFile()));
@@ -33,6 +62,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
 
     QObject::connect(ui->actionCursor, SIGNAL(triggered()), this, SLOT(arrowCursorMode()));
     QObject::connect(ui->actionAddPoint, SIGNAL(triggered()), this, SLOT(addPointCursorMode()));
+    QObject::connect(select_region_action, SIGNAL(triggered()), this, SLOT(selectRegionCursorMode()));
 
     QObject::connect(ui->sliderImageScale, SIGNAL(valueChanged(int)), ui->graphicsViewImage, SLOT(setScaleFactor(int)));
     QObject::connect(ui->checkXAxis, SIGNAL(stateChanged(int)), ui->graphicsViewImage, SLOT(xAxisVisible(int)));
@@ -66,7 +96,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     initPresetsMenu();
 
     // init graph processor
-    QList<VectorTransforms*> vector_trans_filters = {new VectorNoiseClearing(), new VectorMerge(), new VectorNoiseClearing()};
+    VectorResampling *vector_resampling = new VectorResampling();
+    connect(vector_resampling, &VectorResampling::samplesReady, this, &MainWindow::onSamplesReady);
+    connect(vector_resampling, &VectorResampling::stepEnlarged, this, [=](double step) {
+        ui->statusbar->showMessage(QString("Too many samples, resampling step enlarged to %1").arg(step), 5000);
+    });
+    QList<VectorTransforms*> vector_trans_filters = {new VectorNoiseClearing(), new VectorMerge(), new VectorNoiseClearing(), new VectorSimplification(), vector_resampling};
 
     graph_processor = new GraphProcessor(ui->groupGraphProcess);
     graph_processor->setMiddleware(new LinearVectorization(), vector_trans_filters);
@@ -74,6 +109,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     graph_processor->moveToThread(&process_graph_thread);
     connect(graph_processor, &GraphProcessor::resultReady, this, &MainWindow::onProcessGraphEnd);
     connect(this, &MainWindow::startProcessGraph, graph_processor, &GraphProcessor::processGraph);
+    connect(this, &MainWindow::graphTransformChanged, graph_processor, &GraphProcessor::setGraphTransform);
     connect(graph_processor, &GraphProcessor::startCalculating, this, &MainWindow::onStartProgressDialog);
     connect(graph_processor, &GraphProcessor::currentFilter, this, &MainWindow::onProcessProgressDialog);
     connect(graph_processor, &GraphProcessor::finishCalculating, this, &MainWindow::onFinishProgressDialog);
@@ -141,6 +177,28 @@ void MainWindow::initPreprocessorsMenu() {
     });
     ui->menuAddFilter->addAction(color_gradient_filter);
 
+    QAction *multi_scale_edges = new QAction("Multi-scale edges");
+    connect(multi_scale_edges, &QAction::triggered, this, [=]() {
+        image_processor->addMiddleware(new MultiScaleEdges());
+    });
+    ui->menuAddFilter->addAction(multi_scale_edges);
+
+    QAction *perspective_correction = new QAction("Perspective correction");
+    connect(perspective_correction, &QAction::triggered, this, [=]() {
+        // four placed image points become reference corners
+        PerspectiveCorrection *correction = new PerspectiveCorrection();
+        QVector<QPointF> positions = ui->graphicsViewImage->getPointPositions();
+        if (positions.count() == 4) {
+            QStringList points;
+            for (const QPointF &position : positions) {
+                points.append(QString("%1,%2").arg(position.x(), 0, 'f', 1).arg(position.y(), 0, 'f', 1));
+            }
+            correction->setProperty("reference_points", points.join(";"));
+        }
+        image_processor->addMiddleware(correction);
+    });
+    ui->menuAddFilter->addAction(perspective_correction);
+
     QAction *segmentation_filter = new QAction("Segmentation filter");
     connect(segmentation_filter, &QAction::triggered, this, [=]() {
         image_processor->addMiddleware(new SegmentationField());
@@ -182,31 +240,211 @@ void MainWindow::initPresetsMenu() {
     ui->menuPresets->addAction(graphic_analisys);
 }
 
+GraphTransform MainWindow::graphTransform() {
+    GraphTransform graph_transform;
+    // vectorization results are moved to opened image pixels, so axes origin is used as is
+    graph_transform.start_pixel_x = ui->graphicsViewImage->getStartPixelX();
+    graph_transform.start_pixel_y = ui->graphicsViewImage->getStartPixelY();
+    graph_transform.pps_x = ui->graphicsViewImage->getPPSX();
+    graph_transform.pps_y = ui->graphicsViewImage->getPPSY();
+    graph_transform.step_x = ui->graphicsViewImage->getStepX();
+    graph_transform.step_y = ui->graphicsViewImage->getStepY();
+    return graph_transform;
+}
+
+QRect MainWindow::processRegion() {
+    QRect region = ui->graphicsViewImage->getSelectedRegion();
+    if (region.isEmpty() && ui->checkAxesRegion->isChecked())
+        region = ui->graphicsViewImage->getAxesRegion();
+    return region;
+}
+
+void MainWindow::startImageProcessing(const QRect &region) {
+    if (! region.isEmpty()) {
+        // filters also read pixels around region, so it is decoded with halo and cropped after processing
+        int halo = image_processor->halo();
+        QRect padded = region.adjusted(-halo, -halo, halo, halo).intersected(QRect(QPoint(0, 0), opened_size));
+        running_offset = region.topLeft();
+        processed_roi = region.translated(-padded.topLeft());
+        // selected region is decoded alone when full image is not ready yet
+        if (! opened_image.isNull()) {
+            emit startProcessImage(opened_image.copy(padded), processed_roi);
+        }
+        else {
+            region_watcher.setFuture(QtConcurrent::run(ImageLoader::readRegion, opened_filename, padded));
+        }
+    }
+    else if (! opened_image.isNull()) {
+        running_offset = QPoint();
+        processed_roi = QRect();
+        emit startProcessImage(opened_image, processed_roi);
+    }
+    else {
+        image_running = false;
+        ui->statusbar->showMessage("Image is still loading", 3000);
+    }
+}
+
+QByteArray MainWindow::imageCacheKey(const QRect &region) {
+    if (opened_hash.isEmpty())
+        return QByteArray();
+    QByteArray region_part = QString("%1,%2,%3,%4").arg(region.x()).arg(region.y()).arg(region.width()).arg(region.height()).toUtf8();
+    return ResultCache::key({opened_hash, image_processor->chainSignature(), region_part});
+}
+
+QByteArray MainWindow::graphCacheKey(const QByteArray &image_key, const QPoint &offset) {
+    if (image_key.isEmpty())
+        return QByteArray();
+    // simplification in graph units depends on axes scale
+    GraphTransform graph_transform = graphTransform();
+    QByteArray transform_part = QString("%1,%2,%3,%4,%5,%6,%7,%8").arg(offset.x()).arg(offset.y())
+            .arg(graph_transform.start_pixel_x).arg(graph_transform.start_pixel_y)
+            .arg(graph_transform.pps_x).arg(graph_transform.pps_y)
+            .arg(graph_transform.step_x).arg(graph_transform.step_y).toUtf8();
+    return ResultCache::key({image_key, graph_processor->chainSignature(), transform_part});
+}
+
+void MainWindow::initImageScene(const QImage &image) {
+    ui->graphicsViewImage->initSceneItems(image, opened_size);
+    ui->graphicsViewImage->xAxisVisible(ui->checkXAxis->isChecked());
+    ui->graphicsViewImage->yAxisVisible(ui->checkYAxis->isChecked());
+    ui->graphicsViewImage->setPPSX(ui->spinPPSX->value());
+    ui->graphicsViewImage->setPPSY(ui->spinPPSY->value());
+    ui->graphicsViewImage->setStepX(ui->doubleSpinStepX->value());
+    ui->graphicsViewImage->setStepY(ui->doubleSpinStepY->value());
+
+    ui->checkProcessedImage->setDisabled(true);
+    ui->checkProcessedImage->setChecked(false);
+}
+
 // slots
 void MainWindow::onOpenFile() {
     QString filename = QFileDialog::getOpenFileName(this, "Open Image", "/", "Image Files (*.png *.jpg *.bmp)");
     if (filename != "") {
-        opened_pixmap = QPixmap(filename);
-        if (opened_pixmap.isNull()) {
+        QSize size = ImageLoader::imageSize(filename);
+        if (! size.isValid()) {
             QMessageBox::warning(this, "Loading pixmap", "Cannot load image file");
         }
         else {
-            ui->graphicsViewImage->initSceneItems(opened_pixmap);
-            ui->graphicsViewImage->xAxisVisible(ui->checkXAxis->isChecked());
-            ui->graphicsViewImage->yAxisVisible(ui->checkYAxis->isChecked());
-            ui->graphicsViewImage->setPPSX(ui->spinPPSX->value());
-            ui->graphicsViewImage->setPPSY(ui->spinPPSY->value());
-            ui->graphicsViewImage->setStepX(ui->doubleSpinStepX->value());
-            ui->graphicsViewImage->setStepY(ui->doubleSpinStepY->value());
-
-            ui->checkProcessedImage->setDisabled(true);
-            ui->checkProcessedImage->setChecked(false);
+            // region of previous file must not reach processing or cache keys of this one
+            ui->graphicsViewImage->clearSelectedRegion();
+            opened_filename = filename;
+            opened_size = size;
+            opened_image = QImage();
+            opened_preview_shown = false;
+            processed_image = QImage();
+            processed_offset = QPoint();
+            opened_hash.clear();
+            processed_key.clear();
+            graph_key.clear();
+            graph_result.reset();
+            graph_result_graph.reset();
+            graph_samples.reset();
+
+            // reduced preview is shown first, full image replaces it when decoded
+            ui->statusbar->showMessage("Loading image...");
+            preview_watcher.setFuture(QtConcurrent::run(ImageLoader::readPreview, filename, 2048));
+            full_watcher.setFuture(QtConcurrent::run(ImageLoader::readFull, filename));
+            hash_watcher.setFuture(QtConcurrent::run(ResultCache::fileHash, filename));
         }
     }
 }
 
+void MainWindow::onPreviewLoaded() {
+    QImage preview = preview_watcher.result();
+    if (preview.isNull() || ! opened_image.isNull())
+        return;
+
+    initImageScene(preview);
+    opened_preview_shown = true;
+    runCachedResults();
+}
+
+void MainWindow::onFullImageLoaded() {
+    QImage image = full_watcher.result();
+    ui->statusbar->clearMessage();
+    if (image.isNull()) {
+        QMessageBox::warning(this, "Loading pixmap", "Cannot load image file");
+        return;
+    }
+
+    opened_image = image;
+    if (opened_preview_shown) {
+        ui->graphicsViewImage->setOpenedImage(opened_image);
+    }
+    else {
+        initImageScene(opened_image);
+        runCachedResults();
+    }
+}
+
+void MainWindow::onFileHashed() {
+    opened_hash = hash_watcher.result();
+    // axes and region still belong to previous file until scene of this one is shown
+    if (opened_preview_shown || ! opened_image.isNull())
+        runCachedResults();
+}
+
+void MainWindow::runCachedResults() {
+    // run started by user is not interrupted
+    if (opened_hash.isEmpty() || image_running || graph_running)
+        return;
+
+    // scan processed before with current settings goes straight to the chart
+    QRect region = processRegion();
+    QByteArray image_key = imageCacheKey(region);
+    if (ui->comboBoxGraphMode->currentIndex() == 0 && graph_processor->isCacheable() && ! image_key.isEmpty() && ResultCache::containsImage(image_key)
+            && ResultCache::containsProduct(graphCacheKey(image_key, region.topLeft()))) {
+        onProcessAll();
+    }
+}
+
+void MainWindow::onDetectAxes() {
+    if (opened_image.isNull()) {
+        ui->statusbar->showMessage(opened_filename.isEmpty() ? "Open image first" : "Image is still loading", 3000);
+        return;
+    }
+    if (axes_watcher.isRunning())
+        return;
+    ui->statusbar->showMessage("Detecting axes...");
+    axes_watcher.setFuture(QtConcurrent::run(AxisDetector::detect, opened_image, 2.0));
+}
+
+void MainWindow::onAxesDetected() {
+    AxisEstimate estimate = axes_watcher.result();
+    if (! estimate.x_axis_found && ! estimate.y_axis_found) {
+        ui->statusbar->showMessage("Axes not found", 3000);
+        return;
+    }
+
+    // axes which were not found keep their places
+    int start_x = estimate.y_axis_found ? estimate.start_pixel_x : ui->graphicsViewImage->getStartPixelX();
+    int start_y = estimate.x_axis_found ? estimate.start_pixel_y : ui->graphicsViewImage->getStartPixelY();
+    ui->graphicsViewImage->setAxesOrigin(start_x, start_y);
+    // spin boxes pass values on to image view
+    if (estimate.pps_x > 0)
+        ui->spinPPSX->setValue(estimate.pps_x);
+    if (estimate.pps_y > 0)
+        ui->spinPPSY->setValue(estimate.pps_y);
+
+    ui->statusbar->showMessage(QString("Axes origin (%1, %2), pixels per step %3 x %4").arg(start_x).arg(start_y).arg(ui->spinPPSX->value()).arg(ui->spinPPSY->value()), 5000);
+}
+
+void MainWindow::onRegionLoaded() {
+    QImage region = region_watcher.result();
+    if (! region.isNull()) {
+        emit startProcessImage(region, processed_roi);
+    }
+    else {
+        image_running = false;
+        ui->statusbar->showMessage("Cannot load image region", 3000);
+    }
+}
+
 void MainWindow::onExport() {
     export_dialog->setExportImage(processed_image);
+    export_dialog->setExportGraph(graph_result, graph_result_graph, graphTransform());
+    export_dialog->setExportSamples(graph_samples);
     export_dialog->exec();
 }
 
@@ -227,72 +465,92 @@ void MainWindow::graphModeChanged(int index) {
 }
 
 void MainWindow::onProcessImage() {
-    if (! opened_pixmap.isNull()) {
-        emit startProcessImage(opened_pixmap.toImage());
+    if (opened_filename.isEmpty())
+        return;
+    if (image_running) {
+        ui->statusbar->showMessage("Image is still processing", 3000);
+        return;
     }
+    image_running = true;
+
+    // result of the same chain for the same region is loaded instead of processing
+    QRect region = processRegion();
+    running_image_key = imageCacheKey(region);
+    if (! running_image_key.isEmpty() && ResultCache::containsImage(running_image_key)) {
+        running_offset = region.topLeft();
+        processed_roi = QRect();
+        cache_watcher.setFuture(QtConcurrent::run(ResultCache::loadImage, running_image_key));
+        return;
+    }
+    startImageProcessing(region);
+}
+
+void MainWindow::onCachedImageLoaded() {
+    QImage image = cache_watcher.result();
+    if (image.isNull()) {
+        startImageProcessing(processRegion());
+        return;
+    }
+    onProcessImageEnd(image);
 }
 
 void MainWindow::onProcessImageEnd(const QImage &result) {
+    // offset changes together with image, so graph run never pairs old image with new region
     processed_image = result;
-    ui->graphicsViewImage->setProcessedImage(QPixmap::fromImage(processed_image));
+    processed_offset = running_offset;
+    processed_key = running_image_key;
+    image_running = false;
+    if (! processed_key.isEmpty()) {
+        QByteArray key = processed_key;
+        QThreadPool::globalInstance()->start([=]() { ResultCache::storeImage(key, result); });
+    }
+    ui->graphicsViewImage->setProcessedImage(processed_image, processed_offset);
     ui->checkProcessedImage->setDisabled(false);
     emit endProcessImage();
 }
 
-void MainWindow::onProcessGraphEnd(VectorizationProduct result) {
-    int start_x = ui->graphicsViewImage->getStartPixelX(), start_y = processed_image.height() - ui->graphicsViewImage->getStartPixelY();
-    int pps_x = ui->graphicsViewImage->getPPSX(), pps_y = ui->graphicsViewImage->getPPSY();
-    double step_x = ui->graphicsViewImage->getStepX(), step_y = ui->graphicsViewImage->getStepY();
-
-    double g_start_x = (double)(0 - start_x) * (step_x / pps_x), g_start_y = (double)(0 - start_y) * (step_y / pps_y);
-    double g_end_x = (double)(processed_image.width() - start_x) * (step_x / pps_x), g_end_y = (double)(processed_image.height() - start_y) * (step_y / pps_y);
-
-    QChart *chart = new QChart();
-
-    QValueAxis *axisX = new QValueAxis();
-    axisX->setTitleText("x");
-    axisX->setLabelFormat("%g");
-    axisX->setTickInterval(100.0);
-    axisX->setTickAnchor(0.0);
-    axisX->setTickType(QValueAxis::TicksDynamic);
-    axisX->setRange(g_start_x, g_end_x);
-
-    QValueAxis *axisY = new QValueAxis();
-    axisY->setTitleText("y");
-    axisY->setLabelFormat("%g");
-    axisY->setTickInterval(100.0);
-    axisY->setTickAnchor(0.0);
-    axisY->setTickType(QValueAxis::TicksDynamic);
-    axisY->setRange(g_start_y, g_end_y);
-
-    chart->addAxis(axisX, Qt::AlignBottom);
-    chart->addAxis(axisY, Qt::AlignLeft);
-
-    for (auto it = result.begin(); it != result.end(); it++) {
-        QLineSeries *series = new QLineSeries();
-        for (auto it_2 = it->begin(); it_2 != it->end(); it_2++) {
-            QPointF point = *it_2;
-            point.setY(processed_image.height() - point.y());
-            point.setX( (double)(point.x() - start_x) * (step_x / pps_x) );
-            point.setY( (double)(point.y() - start_y) * (step_y / pps_y) );
-            *series << point;
-        }
-        chart->addSeries(series);
-        series->attachAxis(axisX);
-        series->attachAxis(axisY);
+void MainWindow::onProcessGraphEnd(VectorizationResult result) {
+    graph_result = result;
+    graph_result_graph.reset();
+    graph_key = running_graph_key;
+    graph_running = false;
+    if (! graph_key.isEmpty()) {
+        QByteArray key = graph_key;
+        QThreadPool::globalInstance()->start([=]() { ResultCache::storeProduct(key, result); });
     }
 
+    // contours are converted in worker thread, chart is swapped in onChartPrepared
+    // result is already in opened image coordinates
+    GraphTransform graph_transform = graphTransform();
+    QSize image_size = opened_size;
+    chart_batched = ui->checkBatchedChart->isChecked();
+    // worker shares the result with processor, nothing is copied
+    chart_watcher.setFuture(QtConcurrent::run([=]() {
+        return GraphChart::prepareContours(*result, graph_transform, image_size);
+    }));
+}
+
+void MainWindow::onChartPrepared() {
+    QChart *chart = GraphChart::createChart(chart_watcher.result(), chart_batched);
+    QChart *old_chart = this->ui->graphicsViewGraph->chart();
     this->ui->graphicsViewGraph->setChart(chart);
+    delete old_chart; // chart view does not delete replaced chart
     emit endProcessGraph();
 }
 
-void MainWindow::onProcessGraphEnd2(VectorizationProductGraph result) {
-    int start_x = ui->graphicsViewImage->getStartPixelX(), start_y = processed_image.height() - ui->graphicsViewImage->getStartPixelY();
+void MainWindow::onProcessGraphEnd2(VectorizationResultGraph result_ptr) {
+    graph_running = false;
+    graph_result.reset();
+    graph_samples.reset();
+    graph_result_graph = result_ptr;
+    const VectorizationProductGraph &result = *result_ptr;
+    QSize image_size = opened_size;
+    int start_x = ui->graphicsViewImage->getStartPixelX(), start_y = image_size.height() - ui->graphicsViewImage->getStartPixelY();
     int pps_x = ui->graphicsViewImage->getPPSX(), pps_y = ui->graphicsViewImage->getPPSY();
     double step_x = ui->graphicsViewImage->getStepX(), step_y = ui->graphicsViewImage->getStepY();
 
     double g_start_x = (double)(0 - start_x) * (step_x / pps_x), g_start_y = (double)(0 - start_y) * (step_y / pps_y);
-    double g_end_x = (double)(processed_image.width() - start_x) * (step_x / pps_x), g_end_y = (double)(processed_image.height() - start_y) * (step_y / pps_y);
+    double g_end_x = (double)(image_size.width() - start_x) * (step_x / pps_x), g_end_y = (double)(image_size.height() - start_y) * (step_y / pps_y);
 
     QChart *chart = new QChart();
 
@@ -317,7 +575,7 @@ void MainWindow::onProcessGraphEnd2(VectorizationProductGraph result) {
 
     auto transformPoint {
         [&](QPointF point) {
-            point.setY(processed_image.height() - point.y());
+            point.setY(image_size.height() - point.y());
             point.setX( (double)(point.x() - start_x) * (step_x / pps_x) );
             point.setY( (double)(point.y() - start_y) * (step_y / pps_y) );
             return point;
@@ -325,94 +583,95 @@ void MainWindow::onProcessGraphEnd2(VectorizationProductGraph result) {
     };
 
     // here goes showing graph
-
-    /*for (GraphPoint* p : result) {
-        QStack<GraphPoint*> branches;
+    for (int r = 0; r < result.rootCount(); r++) {
+        QStack<int> branches;
         QLineSeries *series;
-        branches.push(p);
-        while(branches.length() > 0) {
-            series = new QLineSeries();
-            GraphPoint* cur_p = branches.pop();
-            QList<GraphPoint*> next_points = cur_p->getNext();
-            if (next_points.length() == 1) {
-                do {
-                    *series << transformPoint(cur_p->point());
-                    cur_p = next_points[0];
-                } while ((next_points = cur_p->getNext()).length() == 1);
-                chart->addSeries(series);
-                series->attachAxis(axisX);
-                series->attachAxis(axisY);
-            }
-            if (next_points.length() > 1) {
-                for (int i = 0; i < next_points.length(); i++) {
-                    branches.push(next_points[i]);
-                }
-            }
-        }
-    }*/
-    for (GraphPoint* p : result) {
-            QStack<GraphPoint*> branches;
-            QLineSeries *series;
-            branches.push(p);
-            while(branches.length() > 0) {
-                GraphPoint* cur_p = branches.pop();
-                QList<GraphPoint*> next_points = cur_p->getNext();
-                if (next_points.length() > 1) {
-                    for (int i = 0; i < next_points.length(); i++) {
-                        series = new QLineSeries();
-                        *series << transformPoint(cur_p->point());
-                        GraphPoint* cur_p2 = next_points[i];
-                        QList<GraphPoint*> next_points2 = cur_p2->getNext();
-                        while ((next_points2 = cur_p2->getNext()).length() == 1) {
-                            *series << transformPoint(cur_p2->point());
-                            cur_p2 = next_points2[0];
-                        }
-                        *series << transformPoint(cur_p2->point());
-                        if (next_points2.length() > 1)
-                            branches.push(cur_p2);
-                        chart->addSeries(series);
-                        series->attachAxis(axisX);
-                        series->attachAxis(axisY);
-                    }
-                }
-                if (next_points.length() == 1) {
+        branches.push(result.root(r));
+        while (branches.length() > 0) {
+            int cur_p = branches.pop();
+            if (result.childCount(cur_p) > 1) {
+                for (const int *next = result.childrenBegin(cur_p); next != result.childrenEnd(cur_p); next++) {
                     series = new QLineSeries();
-                    do {
-                        *series << transformPoint(cur_p->point());
-                        cur_p = next_points[0];
-                    } while ((next_points = cur_p->getNext()).length() == 1);
-                    *series << transformPoint(cur_p->point());
-                    if (next_points.length() > 1)
-                        branches.push(cur_p);
+                    *series << transformPoint(result.point(cur_p));
+                    int cur_p2 = *next;
+                    while (result.childCount(cur_p2) == 1) {
+                        *series << transformPoint(result.point(cur_p2));
+                        cur_p2 = *result.childrenBegin(cur_p2);
+                    }
+                    *series << transformPoint(result.point(cur_p2));
+                    if (result.childCount(cur_p2) > 1)
+                        branches.push(cur_p2);
                     chart->addSeries(series);
                     series->attachAxis(axisX);
                     series->attachAxis(axisY);
                 }
             }
+            if (result.childCount(cur_p) == 1) {
+                series = new QLineSeries();
+                do {
+                    *series << transformPoint(result.point(cur_p));
+                    cur_p = *result.childrenBegin(cur_p);
+                } while (result.childCount(cur_p) == 1);
+                *series << transformPoint(result.point(cur_p));
+                if (result.childCount(cur_p) > 1)
+                    branches.push(cur_p);
+                chart->addSeries(series);
+                series->attachAxis(axisX);
+                series->attachAxis(axisY);
+            }
         }
-
-    for (GraphPoint* p : result) {
-        delete p;
     }
 
     this->ui->graphicsViewGraph->setChart(chart);
     emit endProcessGraph();
 }
 
+void MainWindow::onSamplesReady(ResampledResult samples) {
+    graph_samples = samples;
+}
+
 void MainWindow::onProcessGraph() {
     if (! processed_image.isNull()) {
+        if (graph_running) {
+            ui->statusbar->showMessage("Graph is still processing", 3000);
+            return;
+        }
+        graph_running = true;
         if (ui->comboBoxGraphMode->currentIndex() == 0) {
-            emit startProcessGraph(processed_image);
+            // samples of resampling stage are not cached, such chains always run
+            graph_samples.reset();
+            running_graph_key = graph_processor->isCacheable() ? graphCacheKey(processed_key, processed_offset) : QByteArray();
+            if (! running_graph_key.isEmpty() && ResultCache::containsProduct(running_graph_key)) {
+                product_watcher.setFuture(QtConcurrent::run(ResultCache::loadProduct, running_graph_key));
+                return;
+            }
+            emit graphTransformChanged(graphTransform());
+            emit startProcessGraph(processed_image, processed_offset);
         }
         else if (ui->comboBoxGraphMode->currentIndex() == 1) {
-            emit startProcessGraph2(processed_image);
+            emit startProcessGraph2(processed_image, processed_offset);
         }
     }
 }
 
+void MainWindow::onCachedProductLoaded() {
+    VectorizationResult cached = product_watcher.result();
+    if (cached.isNull()) {
+        // unreadable entry is replaced by a fresh run
+        emit graphTransformChanged(graphTransform());
+        emit startProcessGraph(processed_image, processed_offset);
+        return;
+    }
+    onProcessGraphEnd(cached);
+}
+
 void MainWindow::onProcessAll() {
-    connect(this, SIGNAL(endProcessImage()), this, SLOT(onProcessGraph()));
-    connect(this, SIGNAL(endProcessGraph()), this, SLOT(onProcessAllEnd()));
+    if (image_running || graph_running) {
+        ui->statusbar->showMessage("Processing is still running", 3000);
+        return;
+    }
+    connect(this, SIGNAL(endProcessImage()), this, SLOT(onProcessGraph()), Qt::UniqueConnection);
+    connect(this, SIGNAL(endProcessGraph()), this, SLOT(onProcessAllEnd()), Qt::UniqueConnection);
 
     onProcessImage();
 }
@@ -449,3 +708,7 @@ void MainWindow::arrowCursorMode() {
 void MainWindow::addPointCursorMode() {
     ui->graphicsViewImage->setCursorMode(ImageViewCursorMode::AddPoint);
 }
+
+void MainWindow::selectRegionCursorMode() {
+    ui->graphicsViewImage->setCursorMode(ImageViewCursorMode::SelectRegion);
+}
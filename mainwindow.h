@@ -9,9 +9,16 @@
 #include <QProgressDialog>
 
 #include <QThread>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QThreadPool>
 
 #include "imagepreprocess.h"
 #include "graphpreprocess.h"
+#include "graphchart.h"
+#include "imageloader.h"
+#include "resultcache.h"
+#include "axisdetector.h"
 #include "exportdialog.h"
 
 QT_BEGIN_NAMESPACE
@@ -29,16 +36,41 @@ protected:
     void initUi();
     void initPreprocessorsMenu();
     void initPresetsMenu();
+    GraphTransform graphTransform();
+    void initImageScene(const QImage &image);
+    // selected region, or plot area from axes when enabled
+    QRect processRegion();
+    void startImageProcessing(const QRect &region);
+    // empty until opened file is hashed
+    QByteArray imageCacheKey(const QRect &region);
+    QByteArray graphCacheKey(const QByteArray &image_key, const QPoint &offset);
+    // opened file goes straight to the chart when its results are cached, needs hash and scene of the file
+    void runCachedResults();
 
 private:
     Ui::MainWindow *ui;
     QActionGroup *graph_cursor_action_group;
+    QAction *select_region_action;
     ImageProcessor *image_processor;
     GraphProcessor *graph_processor;
     GraphProcessorGraph *graph_processor_graph;
 
-    QPixmap opened_pixmap;
+    QString opened_filename;
+    QSize opened_size;
+    QImage opened_image;
+    bool opened_preview_shown;
     QImage processed_image;
+    QPoint processed_offset; // position of processed region in opened image
+    QPoint running_offset; // position of region being processed, becomes processed_offset with its result
+    QRect processed_roi; // region of interest inside decoded padded region
+    QByteArray opened_hash; // content hash of opened file
+    QByteArray processed_key, graph_key; // result cache keys of shown results
+    // keys are taken when run starts and move to processed_key and graph_key with its result
+    QByteArray running_image_key, running_graph_key;
+    bool image_running, graph_running; // one run of each kind at a time, so results match their keys
+    VectorizationResult graph_result; // last results for data export
+    VectorizationResultGraph graph_result_graph;
+    ResampledResult graph_samples;
 
     ExportDialog *export_dialog;
     QProgressDialog *progress_dialog;
@@ -46,15 +78,31 @@ private:
     // threads
     QThread process_image_thread;
     QThread process_graph_thread;
+    QFutureWatcher<ChartContours> chart_watcher;
+    QFutureWatcher<QImage> preview_watcher, full_watcher, region_watcher, cache_watcher;
+    QFutureWatcher<QByteArray> hash_watcher;
+    QFutureWatcher<VectorizationResult> product_watcher;
+    QFutureWatcher<AxisEstimate> axes_watcher;
+    bool chart_batched;
 
 public slots:
     void onOpenFile();
+    void onPreviewLoaded();
+    void onFullImageLoaded();
+    void onRegionLoaded();
+    void onFileHashed();
+    void onCachedImageLoaded();
+    void onCachedProductLoaded();
+    void onDetectAxes();
+    void onAxesDetected();
     void onExport();
     void graphModeChanged(int);
     void onProcessImage();
     void onProcessImageEnd(const QImage &);
-    void onProcessGraphEnd(VectorizationProduct); // PRINT GRAPH HERE
-    void onProcessGraphEnd2(VectorizationProductGraph); // PRINT GRAPH HERE
+    void onProcessGraphEnd(VectorizationResult); // PRINT GRAPH HERE
+    void onChartPrepared();
+    void onProcessGraphEnd2(VectorizationResultGraph); // PRINT GRAPH HERE
+    void onSamplesReady(ResampledResult);
     void onProcessGraph();
     void onProcessAll();
     void onProcessAllEnd();
@@ -68,11 +116,13 @@ public slots:
     // toolbar
     void arrowCursorMode();
     void addPointCursorMode();
+    void selectRegionCursorMode();
 
 signals:
-    void startProcessImage(const QImage &);
-    void startProcessGraph(const QImage &);
-    void startProcessGraph2(const QImage &);
+    void startProcessImage(const QImage &, const QRect &);
+    void startProcessGraph(const QImage &, const QPoint &);
+    void startProcessGraph2(const QImage &, const QPoint &);
+    void graphTransformChanged(const GraphTransform &);
     void endProcessImage();
     void endProcessGraph();
 };
@@ -0,0 +1,123 @@
+#include "resultcache.h"
+
+static const qint64 cache_limit = 2048ll * 1024 * 1024;
+
+static QMutex cache_mutex;
+
+static QString cacheDir() {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/results";
+    QDir().mkpath(dir);
+    return dir;
+}
+
+static QString entryPath(const QByteArray &key, const QString &suffix) {
+    return cacheDir() + "/" + QString::fromLatin1(key.toHex()) + suffix;
+}
+
+static void touch(const QString &path) {
+    QFile file(path);
+    if (file.open(QIODevice::ReadWrite))
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+}
+
+QByteArray ResultCache::fileHash(const QString &filename) {
+    QFile file(filename);
+    if (! file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+QByteArray ResultCache::stageSignature(const QObject *stage, bool use) {
+    QByteArray signature = stage->metaObject()->className();
+    signature += use ? ":1" : ":0";
+    // properties of QObject itself do not affect processing
+    const QMetaObject *meta = stage->metaObject();
+    for (int i = QObject::staticMetaObject.propertyCount(); i < meta->propertyCount(); i++) {
+        QMetaProperty prop = meta->property(i);
+        signature += ";" + QByteArray(prop.name()) + "=" + prop.read(stage).toString().toUtf8();
+    }
+    return signature + "\n";
+}
+
+QByteArray ResultCache::key(const QList<QByteArray> &parts) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const QByteArray &part : parts) {
+        // length prefix keeps boundaries of parts
+        hash.addData(QByteArray::number(part.size()) + ":");
+        hash.addData(part);
+    }
+    return hash.result();
+}
+
+bool ResultCache::containsImage(const QByteArray &key) {
+    return QFile::exists(entryPath(key, ".png"));
+}
+
+QImage ResultCache::loadImage(const QByteArray &key) {
+    QString path = entryPath(key, ".png");
+    QImage image(path);
+    if (! image.isNull())
+        touch(path);
+    return image;
+}
+
+void ResultCache::storeImage(const QByteArray &key, const QImage &image) {
+    QMutexLocker locker(&cache_mutex);
+    QString path = entryPath(key, ".png");
+    if (image.isNull() || QFile::exists(path))
+        return;
+    // entry appears only when completely written
+    QSaveFile file(path);
+    if (file.open(QIODevice::WriteOnly) && image.save(&file, "PNG"))
+        file.commit();
+    locker.unlock();
+    trim(cache_limit);
+}
+
+bool ResultCache::containsProduct(const QByteArray &key) {
+    return QFile::exists(entryPath(key, ".gvv"));
+}
+
+VectorizationResult ResultCache::loadProduct(const QByteArray &key) {
+    QString path = entryPath(key, ".gvv");
+    VectorFile file;
+    if (! file.open(path) || file.pointType() != VectorFormat::IntPoints)
+        return VectorizationResult();
+
+    VectorizationProduct product = file.toProduct();
+    file.close();
+    touch(path);
+    return VectorizationResult::create(std::move(product));
+}
+
+void ResultCache::storeProduct(const QByteArray &key, VectorizationResult product) {
+    QMutexLocker locker(&cache_mutex);
+    QString path = entryPath(key, ".gvv");
+    if (product.isNull() || QFile::exists(path))
+        return;
+
+    VectorFileWriter writer(path, VectorFormat::IntPoints);
+    if (writer.open()) {
+        writer.addProduct(*product);
+        writer.finish();
+    }
+    locker.unlock();
+    trim(cache_limit);
+}
+
+void ResultCache::trim(qint64 max_bytes) {
+    QMutexLocker locker(&cache_mutex);
+    QFileInfoList entries = QDir(cacheDir()).entryInfoList(QDir::Files, QDir::Time); // newest first
+    qint64 total = 0;
+    for (const QFileInfo &entry : entries) {
+        total += entry.size();
+        if (total > max_bytes)
+            QFile::remove(entry.absoluteFilePath());
+    }
+}
+
+void ResultCache::clear() {
+    trim(0);
+}
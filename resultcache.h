@@ -0,0 +1,43 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QObject>
+#include <QMetaProperty>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QImage>
+#include <QMutex>
+
+#include "graphpreprocess.h"
+#include "vectorfile.h"
+
+// processed images and vectorization products stored on disk under content hash keys
+// keys are built from hash of opened file and signatures of processing chains,
+// so the same scan processed with the same settings is found again in next sessions
+// functions are safe to call from worker threads
+namespace ResultCache {
+    // SHA1 of file contents
+    QByteArray fileHash(const QString &filename);
+    // class name, use flag and values of all properties of stage
+    QByteArray stageSignature(const QObject *stage, bool use);
+    QByteArray key(const QList<QByteArray> &parts);
+
+    bool containsImage(const QByteArray &key);
+    QImage loadImage(const QByteArray &key);
+    void storeImage(const QByteArray &key, const QImage &image);
+
+    bool containsProduct(const QByteArray &key);
+    // null pointer when entry is missing or damaged
+    VectorizationResult loadProduct(const QByteArray &key);
+    void storeProduct(const QByteArray &key, VectorizationResult product);
+
+    // least recently used entries are removed above size limit
+    void trim(qint64 max_bytes);
+    void clear();
+}
+
+#endif // RESULTCACHE_H
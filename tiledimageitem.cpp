@@ -0,0 +1,177 @@
+#include "tiledimageitem.h"
+
+TiledImageItem::TiledImageItem(QGraphicsItem *parent) : QGraphicsObject(parent) {
+    image_generation = 0;
+    max_level = 0;
+    preview_level = 0;
+    tiles.setMaxCost(256 * 1024); // KB of pixmaps
+
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+TiledImageItem::~TiledImageItem() {}
+
+void TiledImageItem::setImage(const QImage &image, const QImage &preview) {
+    prepareGeometryChange();
+    this->image = image;
+    image_generation++;
+    tiles.clear();
+    pending_tiles.clear();
+
+    // top level holds whole image in one tile
+    max_level = 0;
+    while ((tile_size << max_level) < std::max(image.width(), image.height()))
+        max_level++;
+
+    // preview of at least level resolution replaces image for that level and coarser ones
+    this->preview = preview.isNull() || preview.width() >= image.width() ? QImage() : preview;
+    preview_level = max_level + 1;
+    if (! this->preview.isNull()) {
+        preview_level = 0;
+        while (preview_level <= max_level && (this->preview.width() << preview_level) < image.width())
+            preview_level++;
+    }
+
+    update();
+}
+
+QRectF TiledImageItem::boundingRect() const {
+    return QRectF(image.rect());
+}
+
+quint64 TiledImageItem::tileKey(int level, int tile_x, int tile_y) {
+    return ((quint64)level << 56) | ((quint64)tile_y << 28) | (quint64)tile_x;
+}
+
+QRect TiledImageItem::tileSourceRect(const QSize &image_size, int level, int tile_x, int tile_y) {
+    int span = tile_size << level;
+    return QRect(tile_x * span, tile_y * span, span, span).intersected(QRect(QPoint(0, 0), image_size));
+}
+
+int TiledImageItem::levelFor(double scale) const {
+    int level = 0;
+    while (level < max_level && scale * (2 << level) <= 1)
+        level++;
+    return level;
+}
+
+QImage TiledImageItem::buildTile(const QImage &image, const QImage &preview, int preview_level, int level, int tile_x, int tile_y, const QVector<QImage> &children) {
+    QRect source_rect = tileSourceRect(image.size(), level, tile_x, tile_y);
+    if (level == 0)
+        return image.copy(source_rect);
+
+    QSize size((source_rect.width() + (1 << level) - 1) >> level, (source_rect.height() + (1 << level) - 1) >> level);
+    if (level >= preview_level) {
+        // preview rect is scaled straight into tile
+        double ratio = (double)preview.width() / image.width();
+        QImage tile(size, QImage::Format_ARGB32_Premultiplied);
+        tile.fill(Qt::transparent);
+        QPainter painter(&tile);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(QRectF(tile.rect()), preview, QRectF(QPointF(source_rect.topLeft()) * ratio, QSizeF(source_rect.size()) * ratio));
+        return tile;
+    }
+
+    // children missing in cache are built the same way, so only one branch of tiles is held at a time
+    int child_step = 1 << (level - 1);
+    QImage mosaic(QSize((source_rect.width() + child_step - 1) / child_step, (source_rect.height() + child_step - 1) / child_step), QImage::Format_ARGB32_Premultiplied);
+    mosaic.fill(Qt::transparent);
+    QPainter painter(&mosaic);
+    for (int k = 0; k < 4; k++) {
+        int child_x = tile_x * 2 + (k & 1), child_y = tile_y * 2 + (k >> 1);
+        if (tileSourceRect(image.size(), level - 1, child_x, child_y).isEmpty())
+            continue;
+        QImage child = ! children.value(k).isNull() ? children[k] : buildTile(image, preview, preview_level, level - 1, child_x, child_y, QVector<QImage>());
+        painter.drawImage(QPoint((k & 1) * tile_size, (k >> 1) * tile_size), child);
+    }
+    painter.end();
+    return mosaic.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+void TiledImageItem::requestTile(int level, int tile_x, int tile_y) {
+    quint64 key = tileKey(level, tile_x, tile_y);
+    if (pending_tiles.contains(key))
+        return;
+    pending_tiles.insert(key);
+
+    QImage source = image, source_preview = preview;
+    int source_preview_level = preview_level;
+    QRect source_rect = tileSourceRect(level, tile_x, tile_y);
+    int generation = image_generation;
+
+    // cached children are handed to worker, images are shared and only read there
+    QVector<QImage> children(4);
+    if (level > 0 && level < preview_level) {
+        for (int k = 0; k < 4; k++) {
+            QImage *child = tiles.object(tileKey(level - 1, tile_x * 2 + (k & 1), tile_y * 2 + (k >> 1)));
+            if (child != nullptr)
+                children[k] = *child;
+        }
+    }
+
+    // watcher is owned by item, so result of deleted item is never delivered
+    QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [=]() {
+        watcher->deleteLater();
+        if (generation != image_generation)
+            return;
+        pending_tiles.remove(key);
+        QImage tile = watcher->result();
+        tiles.insert(key, new QImage(tile), std::max<qsizetype>(1, tile.sizeInBytes() / 1024));
+        update(QRectF(source_rect));
+    });
+    watcher->setFuture(QtConcurrent::run(TiledImageItem::buildTile, source, source_preview, source_preview_level, level, tile_x, tile_y, children));
+}
+
+bool TiledImageItem::drawFallback(QPainter *painter, const QRect &source_rect, int level) {
+    for (int l = level + 1; l <= max_level; l++) {
+        int span = tile_size << l;
+        int tile_x = source_rect.x() / span, tile_y = source_rect.y() / span;
+        QImage *tile = tiles.object(tileKey(l, tile_x, tile_y));
+        if (tile != nullptr) {
+            QRectF part(QPointF(source_rect.x() - tile_x * span, source_rect.y() - tile_y * span) / (1 << l), QSizeF(source_rect.size()) / (1 << l));
+            painter->drawImage(QRectF(source_rect), *tile, part);
+            return true;
+        }
+    }
+    // preview is drawn as is until tiles arrive
+    if (! preview.isNull()) {
+        double ratio = (double)preview.width() / image.width();
+        painter->drawImage(QRectF(source_rect), preview, QRectF(QPointF(source_rect.topLeft()) * ratio, QSizeF(source_rect.size()) * ratio));
+        return true;
+    }
+    return false;
+}
+
+void TiledImageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    if (image.isNull())
+        return;
+
+    double scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    int level = levelFor(scale);
+    int span = tile_size << level;
+
+    QRect exposed = option->exposedRect.toAlignedRect().intersected(image.rect());
+    if (exposed.isEmpty())
+        return;
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, level > 0 || scale < 1);
+
+    for (int tile_y = exposed.top() / span; tile_y <= exposed.bottom() / span; tile_y++) {
+        for (int tile_x = exposed.left() / span; tile_x <= exposed.right() / span; tile_x++) {
+            QRect source_rect = tileSourceRect(level, tile_x, tile_y);
+            QImage *tile = tiles.object(tileKey(level, tile_x, tile_y));
+            if (tile != nullptr) {
+                painter->drawImage(QRectF(source_rect), *tile, QRectF(tile->rect()));
+            }
+            else {
+                requestTile(level, tile_x, tile_y);
+                // without preview top tile is built from the tile mosaic, never from a whole image copy
+                if (! drawFallback(painter, source_rect, level) && level != max_level)
+                    requestTile(max_level, 0, 0);
+            }
+        }
+    }
+
+    Q_UNUSED(widget);
+}
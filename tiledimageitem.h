@@ -0,0 +1,53 @@
+#ifndef TILEDIMAGEITEM_H
+#define TILEDIMAGEITEM_H
+
+#include <QGraphicsObject>
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+#include <QPixmap>
+#include <QImage>
+#include <QCache>
+#include <QSet>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+// image drawn by tiles of a resolution pyramid
+// only tiles intersecting exposed area are drawn, at level matching view scale
+// missing tiles are built on worker threads, coarser cached tiles or preview are shown meanwhile
+// tile of level l is a halved mosaic of its four level l - 1 tiles, cached ones are reused,
+// levels not finer than preview are scaled from preview, so full resolution pixels are read only for fine levels
+class TiledImageItem : public QGraphicsObject {
+    Q_OBJECT;
+
+public:
+    explicit TiledImageItem(QGraphicsItem *parent = nullptr);
+    ~TiledImageItem();
+
+    // preview is a reduced copy of image, e.g. one shown while image was decoded
+    void setImage(const QImage &image, const QImage &preview = QImage());
+    const QImage& getImage() { return image; }
+
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+    static const int tile_size = 256;
+
+    QImage image;
+    QImage preview;
+    int preview_level; // first level which tiles are scaled from preview
+    int image_generation;
+    int max_level;
+    QCache<quint64, QImage> tiles; // images are shared with workers, so cached children feed parent tiles
+    QSet<quint64> pending_tiles;
+
+    static quint64 tileKey(int level, int tile_x, int tile_y);
+    static QRect tileSourceRect(const QSize &image_size, int level, int tile_x, int tile_y);
+    QRect tileSourceRect(int level, int tile_x, int tile_y) const { return tileSourceRect(image.size(), level, tile_x, tile_y); }
+    static QImage buildTile(const QImage &image, const QImage &preview, int preview_level, int level, int tile_x, int tile_y, const QVector<QImage> &children);
+    int levelFor(double scale) const;
+    void requestTile(int level, int tile_x, int tile_y);
+    bool drawFallback(QPainter *painter, const QRect &source_rect, int level);
+};
+
+#endif // TILEDIMAGEITEM_H
@@ -0,0 +1,193 @@
+#include "vectorfile.h"
+
+#include <cmath>
+#include <cstring>
+
+bool VectorFile::open(const QString &filename) {
+    close();
+    file.setFileName(filename);
+    if (! file.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size = file.size();
+    const uchar *mapped = size >= (qint64)sizeof(VectorFormat::Header) ? file.map(0, size) : nullptr;
+    if (mapped == nullptr) {
+        file.close();
+        return false;
+    }
+
+    // big-endian hosts see swapped magic and refuse file
+    const VectorFormat::Header *h = reinterpret_cast<const VectorFormat::Header*>(mapped);
+    quint64 table_size = (h->contour_count + 1) * sizeof(quint64);
+    bool valid = h->magic == VectorFormat::magic && h->version == VectorFormat::version
+            && (h->point_type == VectorFormat::IntPoints || h->point_type == VectorFormat::FloatPoints)
+            && h->points_offset == sizeof(VectorFormat::Header)
+            && h->table_offset == h->points_offset + h->point_count * 2 * 4
+            && h->contour_count < (quint64)size && h->point_count < (quint64)size && h->table_offset + table_size == (quint64)size;
+
+    // offsets must grow and end at point count, so contour access never leaves mapping
+    if (valid) {
+        const quint64 *t = reinterpret_cast<const quint64*>(mapped + h->table_offset);
+        valid = t[0] == 0 && t[h->contour_count] == h->point_count;
+        for (quint64 c = 0; valid && c < h->contour_count; c++) {
+            valid = t[c] <= t[c + 1];
+        }
+    }
+    if (! valid) {
+        file.unmap(const_cast<uchar*>(mapped));
+        file.close();
+        return false;
+    }
+
+    data = mapped;
+    header = h;
+    table = reinterpret_cast<const quint64*>(data + header->table_offset);
+    return true;
+}
+
+void VectorFile::close() {
+    if (data != nullptr)
+        file.unmap(const_cast<uchar*>(data));
+    data = nullptr;
+    header = nullptr;
+    table = nullptr;
+    if (file.isOpen())
+        file.close();
+}
+
+const qint32* VectorFile::intPoints(qint64 c) const {
+    if (pointType() != VectorFormat::IntPoints)
+        return nullptr;
+    return reinterpret_cast<const qint32*>(data + header->points_offset) + table[c] * 2;
+}
+
+const float* VectorFile::floatPoints(qint64 c) const {
+    if (pointType() != VectorFormat::FloatPoints)
+        return nullptr;
+    return reinterpret_cast<const float*>(data + header->points_offset) + table[c] * 2;
+}
+
+VectorizationProduct VectorFile::toProduct() const {
+    VectorizationProduct product;
+    if (! isOpen() || pointType() != VectorFormat::IntPoints)
+        return product;
+
+    for (qint64 c = 0; c < contourCount(); c++) {
+        const qint32 *p = intPoints(c);
+        QLinkedList<QPoint> contour;
+        for (qint64 i = 0; i < contourSize(c); i++) {
+            contour.append(QPoint(p[i * 2], p[i * 2 + 1]));
+        }
+        product.append(contour);
+    }
+    return product;
+}
+
+
+
+VectorFileWriter::VectorFileWriter(const QString &filename, VectorFormat::PointType point_type) : file(filename) {
+    this->point_type = point_type;
+}
+
+bool VectorFileWriter::open() {
+    offsets.clear();
+    offsets.append(0);
+    point_count = 0;
+    failed = ! file.open(QIODevice::WriteOnly);
+
+    // header is rewritten with final counts in finish
+    VectorFormat::Header header;
+    memset(&header, 0, sizeof(header));
+    if (! failed)
+        failed = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != (qint64)sizeof(header);
+    return ! failed;
+}
+
+template<typename T> void VectorFileWriter::writePoints(const QVector<T> &values) {
+    if (failed)
+        return;
+    qint64 bytes = values.count() * sizeof(T);
+    failed = file.write(reinterpret_cast<const char*>(values.constData()), bytes) != bytes;
+    point_count += values.count() / 2;
+    offsets.append(point_count);
+}
+
+void VectorFileWriter::addContour(const QLinkedList<QPoint> &contour) {
+    if (point_type == VectorFormat::IntPoints) {
+        QVector<qint32> values;
+        values.reserve(contour.count() * 2);
+        for (const QPoint &point : contour) {
+            values << qToLittleEndian<qint32>(point.x()) << qToLittleEndian<qint32>(point.y());
+        }
+        writePoints(values);
+    }
+    else {
+        QVector<float> values;
+        values.reserve(contour.count() * 2);
+        for (const QPoint &point : contour) {
+            values << qToLittleEndian<float>(point.x()) << qToLittleEndian<float>(point.y());
+        }
+        writePoints(values);
+    }
+}
+
+void VectorFileWriter::addContour(const QPolygonF &contour) {
+    if (point_type == VectorFormat::IntPoints) {
+        QVector<qint32> values;
+        values.reserve(contour.count() * 2);
+        for (const QPointF &point : contour) {
+            values << qToLittleEndian<qint32>(lround(point.x())) << qToLittleEndian<qint32>(lround(point.y()));
+        }
+        writePoints(values);
+    }
+    else {
+        QVector<float> values;
+        values.reserve(contour.count() * 2);
+        for (const QPointF &point : contour) {
+            values << qToLittleEndian<float>(point.x()) << qToLittleEndian<float>(point.y());
+        }
+        writePoints(values);
+    }
+}
+
+void VectorFileWriter::addProduct(const VectorizationProduct &product) {
+    for (auto it = product.begin(); it != product.end(); it++) {
+        addContour(*it);
+    }
+}
+
+void VectorFileWriter::addGraph(const VectorizationProductGraph &graph) {
+    graph.forEachBranch([&](const QLinkedList<QPoint> &branch) {
+        addContour(branch);
+    });
+}
+
+bool VectorFileWriter::finish() {
+    if (! failed) {
+        qint64 table_bytes = offsets.count() * sizeof(quint64);
+        QVector<quint64> table(offsets.count());
+        for (int i = 0; i < offsets.count(); i++) {
+            table[i] = qToLittleEndian<quint64>(offsets[i]);
+        }
+        failed = file.write(reinterpret_cast<const char*>(table.constData()), table_bytes) != table_bytes;
+    }
+
+    if (! failed) {
+        VectorFormat::Header header;
+        memset(&header, 0, sizeof(header));
+        header.magic = qToLittleEndian<quint32>(VectorFormat::magic);
+        header.version = qToLittleEndian<quint16>(VectorFormat::version);
+        header.point_type = qToLittleEndian<quint16>(point_type);
+        header.contour_count = qToLittleEndian<quint64>(offsets.count() - 1);
+        header.point_count = qToLittleEndian<quint64>(point_count);
+        header.points_offset = qToLittleEndian<quint64>(sizeof(VectorFormat::Header));
+        header.table_offset = qToLittleEndian<quint64>(sizeof(VectorFormat::Header) + point_count * 2 * 4);
+        failed = ! file.seek(0) || file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != (qint64)sizeof(header);
+    }
+
+    if (failed) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
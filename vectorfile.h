@@ -0,0 +1,97 @@
+#ifndef VECTORFILE_H
+#define VECTORFILE_H
+
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include <QVector>
+#include <QPolygonF>
+#include <QLinkedList>
+#include <QPoint>
+#include <QtEndian>
+
+#include "graphpreprocess.h"
+
+// binary file of contours, designed to be memory-mapped and read without parsing
+// layout: header, interleaved x y arrays of all points, contour offset table (contours + 1 point indexes)
+// numbers are little-endian, points are int32 (image pixels) or float32 (graph units)
+// table is written last, so writer streams points of any count and keeps only offsets in memory
+namespace VectorFormat {
+    const quint32 magic = 0x46565647; // "GVVF" in file
+    const quint16 version = 1;
+
+    enum PointType : quint16 {
+        IntPoints = 0,
+        FloatPoints = 1
+    };
+
+    // 64 bytes, so point arrays and table behind it stay aligned
+    struct Header {
+        quint32 magic;
+        quint16 version;
+        quint16 point_type;
+        quint64 contour_count;
+        quint64 point_count;
+        quint64 points_offset; // bytes from file start
+        quint64 table_offset;
+        quint8 reserved[24];
+    };
+    static_assert(sizeof(Header) == 64, "vector file header must stay 64 bytes");
+}
+
+// read-only view of mapped vector file
+class VectorFile {
+private:
+    QFile file;
+    const uchar *data = nullptr;
+    const VectorFormat::Header *header = nullptr;
+    const quint64 *table = nullptr;
+
+public:
+    VectorFile() {}
+    ~VectorFile() { close(); }
+    Q_DISABLE_COPY(VectorFile);
+
+    // maps file and checks header and offset table, points are not touched
+    bool open(const QString &filename);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    VectorFormat::PointType pointType() const { return (VectorFormat::PointType)header->point_type; }
+    qint64 contourCount() const { return header->contour_count; }
+    qint64 pointCount() const { return header->point_count; }
+    qint64 contourSize(qint64 c) const { return table[c + 1] - table[c]; }
+    // x y pairs of contour inside mapped memory, null for other point type
+    const qint32* intPoints(qint64 c) const;
+    const float* floatPoints(qint64 c) const;
+
+    // copies contours of int file into product
+    VectorizationProduct toProduct() const;
+};
+
+// streams contours into vector file, file appears under its name only after finish
+class VectorFileWriter {
+private:
+    QSaveFile file;
+    VectorFormat::PointType point_type;
+    QVector<quint64> offsets;
+    quint64 point_count = 0;
+    bool failed = false;
+
+    template<typename T> void writePoints(const QVector<T> &values);
+
+public:
+    explicit VectorFileWriter(const QString &filename, VectorFormat::PointType point_type);
+
+    bool open();
+    // points are rounded or converted to point type of file
+    void addContour(const QLinkedList<QPoint> &contour);
+    void addContour(const QPolygonF &contour);
+    void addProduct(const VectorizationProduct &product);
+    // every graph branch becomes one contour
+    void addGraph(const VectorizationProductGraph &graph);
+    // writes offset table and header, false when any write failed
+    bool finish();
+};
+
+#endif // VECTORFILE_H